@@ -22,6 +22,12 @@
  *
  *****************************************************************************/
 
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
 #include "lynsyn.h"
 
 #include <ctype.h>
@@ -31,6 +37,7 @@
 #include <assert.h>
 #include <string.h>
 #include <math.h>
+#include <time.h>
 
 #include <libusb.h>
 
@@ -51,6 +58,8 @@
 #define CURRENT_SENSOR_GAIN_V2 20
 #define CURRENT_SENSOR_FACTOR_V2 0.125
 
+#define LOW_JITTER_STACK_PREFAULT (256 * 1024)
+
 ///////////////////////////////////////////////////////////////////////////////
 
 bool setBreakpoint(uint8_t type, uint8_t core, uint64_t addr);
@@ -65,6 +74,8 @@ void convertSample(struct LynsynSample *dest, struct SampleReplyPacket *source);
 uint8_t getCurrentChannel(uint8_t sensor);
 uint8_t getVoltageChannel(uint8_t sensor);
 static bool lynsyn_getNext(void);
+static void resetTransferStats(void);
+static void recordTransfer(unsigned samples);
 
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -99,6 +110,10 @@ unsigned pointNumVoltage[LYNSYN_MAX_SENSORS];
 static double lastWantedVoltage[LYNSYN_MAX_SENSORS];
 static double lastActualVoltage[LYNSYN_MAX_SENSORS];
 
+static struct LynsynTransferStats transferStats;
+static int64_t lastTransferNs;
+static double totalInterval;
+
 ///////////////////////////////////////////////////////////////////////////////
 
 bool lynsyn_preinit(unsigned maxTries) {
@@ -788,7 +803,16 @@ bool lynsyn_setMarkBreakpoint(uint64_t addr) {
   return false;
 }
 
+void lynsyn_clearMarkBreakpoint(void) {
+  useMarkBp = false;
+}
+
 void lynsyn_startPeriodSampling(double duration, uint64_t cores) {
+  lynsyn_continuePeriodSampling(duration, cores);
+  resetTransferStats();
+}
+
+void lynsyn_continuePeriodSampling(double duration, uint64_t cores) {
   struct StartSamplingRequestPacket req;
   req.request.cmd = USB_CMD_START_SAMPLING;
   req.samplePeriod = lynsyn_secondsToCycles(duration);
@@ -812,6 +836,7 @@ void lynsyn_startBpPeriodSampling(uint64_t startAddr, double duration, uint64_t
 
   samplesLeft = 0;
   buf = sampleBuf;
+  resetTransferStats();
 }
 
 void lynsyn_startBpSampling(uint64_t startAddr, uint64_t endAddr, uint64_t cores) {
@@ -828,12 +853,14 @@ void lynsyn_startBpSampling(uint64_t startAddr, uint64_t endAddr, uint64_t cores
 
   samplesLeft = 0;
   buf = sampleBuf;
+  resetTransferStats();
 }
 
 static bool lynsyn_getNext(void) {
   if(samplesLeft == 0) {
     bool transferOk = getArray((uint8_t*)sampleBuf, MAX_SAMPLES, sizeof(struct SampleReplyPacket), &samplesLeft, 0);
     if(!transferOk) return false;
+    recordTransfer(samplesLeft);
     buf = sampleBuf;
 
   } else {
@@ -853,6 +880,103 @@ bool lynsyn_getNextSample(struct LynsynSample *sample) {
   return true;
 }
 
+static int64_t monotonicNs(void) {
+#ifndef _WIN32
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+static void resetTransferStats(void) {
+  memset(&transferStats, 0, sizeof(transferStats));
+  lastTransferNs = -1;
+  totalInterval = 0;
+}
+
+static void recordTransfer(unsigned samples) {
+  int64_t now = monotonicNs();
+
+  if(lastTransferNs != -1) {
+    double interval = (now - lastTransferNs) / 1e9;
+
+    if((transferStats.transfers == 1) || (interval < transferStats.minInterval)) transferStats.minInterval = interval;
+    if(interval > transferStats.maxInterval) transferStats.maxInterval = interval;
+    totalInterval += interval;
+
+    uint64_t us = (now - lastTransferNs) / 1000;
+    unsigned bucket = 0;
+    while(us && (bucket < LYNSYN_TRANSFER_BUCKETS - 1)) {
+      us >>= 1;
+      bucket++;
+    }
+    transferStats.histogram[bucket]++;
+  }
+
+  lastTransferNs = now;
+  transferStats.transfers++;
+  transferStats.samples += samples;
+}
+
+bool lynsyn_getTransferStats(struct LynsynTransferStats *stats) {
+  *stats = transferStats;
+  if(stats->transfers > 1) stats->meanInterval = totalInterval / (stats->transfers - 1);
+#ifndef _WIN32
+  return true;
+#else
+  // no monotonic clock, only the counts are valid
+  return false;
+#endif
+}
+
+bool lynsyn_setLowJitter(int cpu, int priority) {
+#ifdef __linux__
+  bool ok = true;
+
+  if(cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if(sched_setaffinity(0, sizeof(set), &set) != 0) {
+      printf("Can't run on CPU %d\n", cpu);
+      ok = false;
+    }
+  }
+
+  if(priority > 0) {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    if(sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+      printf("Can't use real-time scheduling (needs CAP_SYS_NICE or an rtprio limit)\n");
+      ok = false;
+    }
+  }
+
+  if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+    printf("Can't lock memory (needs CAP_IPC_LOCK or a higher memlock limit)\n");
+    ok = false;
+  }
+
+  // touch the stack so it is mapped before sampling starts.  Written through
+  // volatile so the stores are not optimised away
+  volatile char stack[LOW_JITTER_STACK_PREFAULT];
+  for(unsigned i = 0; i < sizeof(stack); i += 4096) {
+    stack[i] = 0;
+  }
+
+  fflush(stdout);
+
+  return ok;
+#else
+  printf("Low jitter mode is only supported on Linux\n");
+  fflush(stdout);
+  return false;
+#endif
+}
+
 bool lynsyn_getSample(struct LynsynSample *sample, bool average, uint64_t cores) {
   struct GetSampleRequestPacket req;
   req.request.cmd = USB_CMD_GET_SAMPLE;
@@ -40,6 +40,7 @@ extern "C" {
 
 #define SAMPLE_FLAG_MARK       SAMPLE_REPLY_FLAG_MARK    // the sample is a mark
 #define SAMPLE_FLAG_HALTED     SAMPLE_REPLY_FLAG_HALTED  // sampling has stopped
+#define SAMPLE_FLAG_GAP        0x8000                    // not from the board: no samples were taken from time until pc[0]
 
 enum { LYNSYN_DEVICELIST_END, LYNSYN_ARMV7, LYNSYN_ARMV8, LYNSYN_JTAG };
 
@@ -51,6 +52,18 @@ struct LynsynJtagDevice {
   uint32_t pidrmask[5];
 };
 
+#define LYNSYN_TRANSFER_BUCKETS 24
+
+/** Timing of the USB transfers since sampling was started */
+struct LynsynTransferStats {
+  uint64_t transfers; /** Number of completed transfers */
+  uint64_t samples; /** Number of samples received */
+  double minInterval; /** Shortest time between two transfers (in seconds) */
+  double maxInterval; /** Longest time between two transfers (in seconds) */
+  double meanInterval; /** Mean time between two transfers (in seconds) */
+  uint64_t histogram[LYNSYN_TRANSFER_BUCKETS]; /** Bucket 0 counts intervals below 1us, bucket i counts intervals in [2^(i-1), 2^i) us.  The last bucket counts all longer intervals */
+};
+
 struct LynsynSample {
   int64_t time; /** Sample time (in cycles).  Use lynsyn_cyclesToSeconds() to convert to seconds */
   uint64_t pc[LYNSYN_MAX_CORES]; /** Program counter of sampled cores */
@@ -134,6 +147,9 @@ bool lynsyn_shift(int numBits, uint8_t *tmsVector, uint8_t *tdiVector, uint8_t *
  */
 bool lynsyn_setMarkBreakpoint(uint64_t addr);
 
+/** Stop using the mark breakpoint in the following sampling runs */
+void lynsyn_clearMarkBreakpoint(void);
+
 /**
  * Start period sampling.  This starts sampling immediately and runs for the given amount of time
  * Use lynsyn_getNextSample() to collect the samples.
@@ -142,6 +158,14 @@ bool lynsyn_setMarkBreakpoint(uint64_t addr);
  */
 void lynsyn_startPeriodSampling(double duration, uint64_t cores);
 
+/**
+ * Start another period after the previous one has ended, as lynsyn_startPeriodSampling(),
+ * but the transfer statistics keep counting from the first period.
+ * @param duration Duration in seconds
+ * @param cores A bitmask of the cores where PC sampling is performed.  0 means PC sampling is disabled
+ */
+void lynsyn_continuePeriodSampling(double duration, uint64_t cores);
+
 /**
  * Start breakpoint sampling.  Sampling starts when reaching the start breakpoint and stops when reaching the end breakpoint
  * Use lynsyn_getNextSample() to collect the samples.
@@ -180,6 +204,25 @@ bool lynsyn_getSample(struct LynsynSample *sample, bool average, uint64_t cores)
 
 bool lynsyn_getAvgSample(struct LynsynSample *sample, double duration, uint64_t cores);
 
+/**
+ * Reduces scheduling jitter for the thread that calls lynsyn_getNextSample().
+ * Pins the calling thread to the given CPU, requests SCHED_FIFO scheduling,
+ * locks all current and future memory and prefaults the stack.  Call this
+ * from the sampling thread before sampling is started.  Only available on Linux.
+ * @param cpu CPU to run on.  Negative means no pinning
+ * @param priority Real-time priority.  0 means normal scheduling
+ * @return true if all requested settings were applied.  Failing settings do not prevent the others
+ */
+bool lynsyn_setLowJitter(int cpu, int priority);
+
+/**
+ * Get the USB transfer timing since sampling was last started.  The intervals
+ * are not measured on Windows.
+ * @param stats Where the statistics are stored
+ * @return false if only the transfer and sample counts are valid
+ */
+bool lynsyn_getTransferStats(struct LynsynTransferStats *stats);
+
 /*****************************************************************************/
 /* HW setup and calibration */
 
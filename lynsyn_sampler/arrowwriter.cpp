@@ -0,0 +1,494 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <string.h>
+
+#include "arrowwriter.h"
+
+// Arrow IPC flatbuffer schema (format/Message.fbs, format/Schema.fbs, format/File.fbs)
+
+#define ARROW_MAGIC "ARROW1"
+#define ARROW_CONTINUATION 0xffffffff
+
+#define METADATA_V5 4
+
+#define MESSAGE_VERSION 0
+#define MESSAGE_HEADER_TYPE 1
+#define MESSAGE_HEADER 2
+#define MESSAGE_BODY_LENGTH 3
+
+#define HEADER_SCHEMA 1
+#define HEADER_DICTIONARY_BATCH 2
+#define HEADER_RECORD_BATCH 3
+
+#define SCHEMA_ENDIANNESS 0
+#define SCHEMA_FIELDS 1
+
+#define FIELD_NAME 0
+#define FIELD_NULLABLE 1
+#define FIELD_TYPE_TYPE 2
+#define FIELD_TYPE 3
+#define FIELD_DICTIONARY 4
+#define FIELD_CHILDREN 5
+
+#define TYPE_INT 2
+#define TYPE_FLOATING_POINT 3
+#define TYPE_UTF8 5
+
+#define DICTIONARY_ENCODING_ID 0
+#define DICTIONARY_ENCODING_INDEX_TYPE 1
+
+#define DICTIONARY_BATCH_ID 0
+#define DICTIONARY_BATCH_DATA 1
+
+#define INT_BIT_WIDTH 0
+#define INT_IS_SIGNED 1
+
+#define FLOATING_POINT_PRECISION 0
+#define PRECISION_DOUBLE 2
+
+#define RECORD_BATCH_LENGTH 0
+#define RECORD_BATCH_NODES 1
+#define RECORD_BATCH_BUFFERS 2
+
+#define FOOTER_VERSION 0
+#define FOOTER_SCHEMA 1
+#define FOOTER_DICTIONARIES 2
+#define FOOTER_RECORD_BATCHES 3
+
+// column types
+#define COLUMN_FLOAT 0
+#define COLUMN_UINT 1
+#define COLUMN_DICTIONARY 2
+
+#define DICTIONARY_FUNCTIONS 0
+#define DICTIONARY_MODULES 1
+
+struct ArrowFieldNode {
+  int64_t length;
+  int64_t nullCount;
+};
+
+struct ArrowBuffer {
+  int64_t offset;
+  int64_t length;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+void FlatBuilder::prepend(const void *data, size_t size) {
+  buf.insert(buf.begin(), (const uint8_t*)data, (const uint8_t*)data + size);
+}
+
+void FlatBuilder::align(size_t size, size_t alignment) {
+  while((buf.size() + size) % alignment) buf.insert(buf.begin(), 0);
+}
+
+uint32_t FlatBuilder::createString(const std::string &str) {
+  align(str.size() + 1, 4);
+  buf.insert(buf.begin(), 0);
+  prepend(str.data(), str.size());
+  uint32_t len = str.size();
+  prepend(&len, 4);
+  return buf.size();
+}
+
+uint32_t FlatBuilder::createOffsetVector(const std::vector<uint32_t> &offsets) {
+  align(offsets.size() * 4, 4);
+  for(int i = offsets.size() - 1; i >= 0; i--) {
+    uint32_t offset = buf.size() + 4 - offsets[i];
+    prepend(&offset, 4);
+  }
+  uint32_t len = offsets.size();
+  prepend(&len, 4);
+  return buf.size();
+}
+
+uint32_t FlatBuilder::createStructVector(const void *data, size_t elemSize, size_t count) {
+  align(elemSize * count, 8);
+  prepend(data, elemSize * count);
+  uint32_t len = count;
+  prepend(&len, 4);
+  return buf.size();
+}
+
+void FlatBuilder::startTable() {
+  fields.clear();
+  tableEnd = buf.size();
+}
+
+void FlatBuilder::addOffset(unsigned field, uint32_t offset) {
+  align(4, 4);
+  uint32_t val = buf.size() + 4 - offset;
+  prepend(&val, 4);
+  fields.push_back(std::make_pair(field, (uint32_t)buf.size()));
+}
+
+uint32_t FlatBuilder::endTable() {
+  align(4, 4);
+  int32_t placeholder = 0;
+  prepend(&placeholder, 4);
+  uint32_t table = buf.size();
+
+  unsigned numFields = 0;
+  for(auto field : fields) {
+    if(field.first + 1 > numFields) numFields = field.first + 1;
+  }
+
+  std::vector<uint16_t> vtable(2 + numFields, 0);
+  vtable[0] = vtable.size() * 2;
+  vtable[1] = table - tableEnd;
+  for(auto field : fields) {
+    vtable[2 + field.first] = table - field.second;
+  }
+  prepend(vtable.data(), vtable.size() * 2);
+
+  // the table refers to its vtable by a signed offset back from the table start
+  int32_t vtableOffset = buf.size() - table;
+  memcpy(&buf[buf.size() - table], &vtableOffset, 4);
+
+  return table;
+}
+
+std::string FlatBuilder::finish(uint32_t root) {
+  align(4, 8);
+  uint32_t offset = buf.size() + 4 - root;
+  prepend(&offset, 4);
+
+  std::string result((char*)buf.data(), buf.size());
+  buf.clear();
+  return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void ArrowWriter::addColumn(std::string name, unsigned type, unsigned width, int dictionary) {
+  ArrowColumn column;
+  column.name = name;
+  column.type = type;
+  column.width = width;
+  column.dictionary = dictionary;
+  column.data.reserve(ARROW_BATCH_ROWS * width);
+  columns.push_back(column);
+}
+
+uint32_t ArrowWriter::buildSchema(FlatBuilder &builder) {
+  std::vector<uint32_t> fieldOffsets;
+
+  for(auto &column : columns) {
+    uint32_t name = builder.createString(column.name);
+    uint32_t children = builder.createOffsetVector(std::vector<uint32_t>());
+
+    uint32_t dictionary = 0;
+    uint8_t typeType;
+
+    builder.startTable();
+    if(column.type == COLUMN_FLOAT) {
+      builder.addInt16(FLOATING_POINT_PRECISION, PRECISION_DOUBLE);
+      typeType = TYPE_FLOATING_POINT;
+    } else if(column.type == COLUMN_UINT) {
+      builder.addInt32(INT_BIT_WIDTH, column.width * 8);
+      builder.addUint8(INT_IS_SIGNED, 0);
+      typeType = TYPE_INT;
+    } else {
+      // the field type is the value type, the indices are described by the encoding
+      typeType = TYPE_UTF8;
+    }
+    uint32_t type = builder.endTable();
+
+    if(column.type == COLUMN_DICTIONARY) {
+      builder.startTable();
+      builder.addInt32(INT_BIT_WIDTH, column.width * 8);
+      builder.addUint8(INT_IS_SIGNED, 1);
+      uint32_t indexType = builder.endTable();
+
+      builder.startTable();
+      builder.addInt64(DICTIONARY_ENCODING_ID, column.dictionary);
+      builder.addOffset(DICTIONARY_ENCODING_INDEX_TYPE, indexType);
+      dictionary = builder.endTable();
+    }
+
+    builder.startTable();
+    builder.addOffset(FIELD_NAME, name);
+    builder.addOffset(FIELD_TYPE, type);
+    if(dictionary) builder.addOffset(FIELD_DICTIONARY, dictionary);
+    builder.addOffset(FIELD_CHILDREN, children);
+    builder.addUint8(FIELD_NULLABLE, 0);
+    builder.addUint8(FIELD_TYPE_TYPE, typeType);
+    fieldOffsets.push_back(builder.endTable());
+  }
+
+  uint32_t fields = builder.createOffsetVector(fieldOffsets);
+
+  builder.startTable();
+  builder.addOffset(SCHEMA_FIELDS, fields);
+  builder.addInt16(SCHEMA_ENDIANNESS, 0);
+  return builder.endTable();
+}
+
+void ArrowWriter::write(const void *data, size_t size) {
+  out.write((const char*)data, size);
+  position += size;
+}
+
+void ArrowWriter::writePadding(size_t size) {
+  static const char zeros[8] = { 0 };
+  write(zeros, size);
+}
+
+ArrowWriter::ArrowBlock ArrowWriter::writeMessage(const std::string &metadata, uint64_t bodyLength) {
+  ArrowBlock block;
+  block.offset = position;
+  block.metaDataLength = 8 + ((metadata.size() + 7) & ~7);
+  block.padding = 0;
+  block.bodyLength = bodyLength;
+
+  uint32_t continuation = ARROW_CONTINUATION;
+  int32_t len = block.metaDataLength - 8;
+  write(&continuation, 4);
+  write(&len, 4);
+  write(metadata.data(), metadata.size());
+  writePadding(len - metadata.size());
+
+  return block;
+}
+
+void ArrowWriter::writeBatch() {
+  std::vector<ArrowFieldNode> nodes(columns.size());
+  std::vector<ArrowBuffer> buffers(columns.size() * 2);
+
+  // body: per column an empty validity bitmap and the values, 8 byte aligned
+  uint64_t bodyLength = 0;
+  for(unsigned i = 0; i < columns.size(); i++) {
+    nodes[i].length = rows;
+    nodes[i].nullCount = 0;
+    buffers[i * 2].offset = bodyLength;
+    buffers[i * 2].length = 0;
+    buffers[i * 2 + 1].offset = bodyLength;
+    buffers[i * 2 + 1].length = columns[i].data.size();
+    bodyLength += (columns[i].data.size() + 7) & ~7;
+  }
+
+  FlatBuilder builder;
+  uint32_t nodeVector = builder.createStructVector(nodes.data(), sizeof(ArrowFieldNode), nodes.size());
+  uint32_t bufferVector = builder.createStructVector(buffers.data(), sizeof(ArrowBuffer), buffers.size());
+
+  builder.startTable();
+  builder.addInt64(RECORD_BATCH_LENGTH, rows);
+  builder.addOffset(RECORD_BATCH_NODES, nodeVector);
+  builder.addOffset(RECORD_BATCH_BUFFERS, bufferVector);
+  uint32_t batch = builder.endTable();
+
+  builder.startTable();
+  builder.addInt64(MESSAGE_BODY_LENGTH, bodyLength);
+  builder.addOffset(MESSAGE_HEADER, batch);
+  builder.addInt16(MESSAGE_VERSION, METADATA_V5);
+  builder.addUint8(MESSAGE_HEADER_TYPE, HEADER_RECORD_BATCH);
+  uint32_t message = builder.endTable();
+
+  blocks.push_back(writeMessage(builder.finish(message), bodyLength));
+
+  for(auto &column : columns) {
+    write(column.data.data(), column.data.size());
+    writePadding(((column.data.size() + 7) & ~7) - column.data.size());
+    column.data.clear();
+  }
+
+  rows = 0;
+}
+
+void ArrowWriter::writeDictionary(int64_t id, const std::vector<std::string> &values) {
+  std::vector<int32_t> offsets;
+  std::string data;
+
+  offsets.push_back(0);
+  for(auto &value : values) {
+    data += value;
+    offsets.push_back(data.size());
+  }
+
+  size_t offsetsLength = offsets.size() * 4;
+  size_t offsetsPadded = (offsetsLength + 7) & ~7;
+  size_t dataPadded = (data.size() + 7) & ~7;
+
+  ArrowFieldNode node;
+  node.length = values.size();
+  node.nullCount = 0;
+
+  ArrowBuffer buffers[3];
+  buffers[0].offset = 0;
+  buffers[0].length = 0;
+  buffers[1].offset = 0;
+  buffers[1].length = offsetsLength;
+  buffers[2].offset = offsetsPadded;
+  buffers[2].length = data.size();
+
+  FlatBuilder builder;
+  uint32_t nodeVector = builder.createStructVector(&node, sizeof(ArrowFieldNode), 1);
+  uint32_t bufferVector = builder.createStructVector(buffers, sizeof(ArrowBuffer), 3);
+
+  builder.startTable();
+  builder.addInt64(RECORD_BATCH_LENGTH, values.size());
+  builder.addOffset(RECORD_BATCH_NODES, nodeVector);
+  builder.addOffset(RECORD_BATCH_BUFFERS, bufferVector);
+  uint32_t batch = builder.endTable();
+
+  builder.startTable();
+  builder.addInt64(DICTIONARY_BATCH_ID, id);
+  builder.addOffset(DICTIONARY_BATCH_DATA, batch);
+  uint32_t dictionaryBatch = builder.endTable();
+
+  builder.startTable();
+  builder.addInt64(MESSAGE_BODY_LENGTH, offsetsPadded + dataPadded);
+  builder.addOffset(MESSAGE_HEADER, dictionaryBatch);
+  builder.addInt16(MESSAGE_VERSION, METADATA_V5);
+  builder.addUint8(MESSAGE_HEADER_TYPE, HEADER_DICTIONARY_BATCH);
+  uint32_t message = builder.endTable();
+
+  dictionaryBlocks.push_back(writeMessage(builder.finish(message), offsetsPadded + dataPadded));
+
+  write(offsets.data(), offsetsLength);
+  writePadding(offsetsPadded - offsetsLength);
+  write(data.data(), data.size());
+  writePadding(dataPadded - data.size());
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void ArrowWriter::writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask) {
+  SampleWriter::writeHeader(sensors, cores, coreMask);
+
+  columns.clear();
+  blocks.clear();
+  dictionaryBlocks.clear();
+  rows = 0;
+  position = 0;
+
+  addColumn("time", COLUMN_FLOAT, 8);
+  for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
+    if(coreMask & (1 << core)) addColumn("pc " + std::to_string(core), COLUMN_UINT, 8);
+  }
+  for(unsigned sensor = 0; sensor < sensors; sensor++) {
+    addColumn("current " + std::to_string(sensor), COLUMN_FLOAT, 8);
+  }
+  for(unsigned sensor = 0; sensor < sensors; sensor++) {
+    addColumn("voltage " + std::to_string(sensor), COLUMN_FLOAT, 8);
+  }
+  addColumn("flags", COLUMN_UINT, 2);
+  if(symbols) {
+    for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
+      if(coreMask & (1 << core)) {
+        addColumn("function " + std::to_string(core), COLUMN_DICTIONARY, 4, DICTIONARY_FUNCTIONS);
+        addColumn("module " + std::to_string(core), COLUMN_DICTIONARY, 4, DICTIONARY_MODULES);
+      }
+    }
+  }
+
+  write(ARROW_MAGIC, 6);
+  writePadding(2);
+
+  FlatBuilder builder;
+  uint32_t schema = buildSchema(builder);
+
+  builder.startTable();
+  builder.addInt64(MESSAGE_BODY_LENGTH, 0);
+  builder.addOffset(MESSAGE_HEADER, schema);
+  builder.addInt16(MESSAGE_VERSION, METADATA_V5);
+  builder.addUint8(MESSAGE_HEADER_TYPE, HEADER_SCHEMA);
+  uint32_t message = builder.endTable();
+
+  writeMessage(builder.finish(message), 0);
+
+  if(symbols) {
+    writeDictionary(DICTIONARY_FUNCTIONS, symbols->functionNames());
+    writeDictionary(DICTIONARY_MODULES, symbols->moduleNames());
+  }
+}
+
+void ArrowWriter::writeSample(struct LynsynSample *sample) {
+  if(sample->flags & SAMPLE_FLAG_GAP) return;
+
+  std::vector<ArrowColumn>::iterator column = columns.begin();
+
+  double time = lynsyn_cyclesToSeconds(sample->time);
+  column->data.insert(column->data.end(), (uint8_t*)&time, (uint8_t*)&time + 8);
+  column++;
+
+  for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
+    if(coreMask & (1 << core)) {
+      column->data.insert(column->data.end(), (uint8_t*)&sample->pc[core], (uint8_t*)&sample->pc[core] + 8);
+      column++;
+    }
+  }
+  for(unsigned sensor = 0; sensor < sensors; sensor++) {
+    column->data.insert(column->data.end(), (uint8_t*)&sample->current[sensor], (uint8_t*)&sample->current[sensor] + 8);
+    column++;
+  }
+  for(unsigned sensor = 0; sensor < sensors; sensor++) {
+    column->data.insert(column->data.end(), (uint8_t*)&sample->voltage[sensor], (uint8_t*)&sample->voltage[sensor] + 8);
+    column++;
+  }
+  column->data.insert(column->data.end(), (uint8_t*)&sample->flags, (uint8_t*)&sample->flags + 2);
+  column++;
+
+  if(symbols) {
+    for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
+      if(coreMask & (1 << core)) {
+        const struct Symbol *symbol = symbols->lookup(sample->pc[core]);
+        int32_t function = symbol ? symbol->name : SYMBOL_UNKNOWN;
+        int32_t module = symbol ? symbol->module : SYMBOL_UNKNOWN;
+        column->data.insert(column->data.end(), (uint8_t*)&function, (uint8_t*)&function + 4);
+        column++;
+        column->data.insert(column->data.end(), (uint8_t*)&module, (uint8_t*)&module + 4);
+        column++;
+      }
+    }
+  }
+
+  if(++rows == ARROW_BATCH_ROWS) writeBatch();
+}
+
+void ArrowWriter::finish() {
+  if(rows) writeBatch();
+
+  // end of stream marker
+  uint32_t eos[2] = { ARROW_CONTINUATION, 0 };
+  write(eos, 8);
+
+  FlatBuilder builder;
+  uint32_t schema = buildSchema(builder);
+  uint32_t dictionaries = builder.createStructVector(dictionaryBlocks.data(), sizeof(ArrowBlock), dictionaryBlocks.size());
+  uint32_t recordBatches = builder.createStructVector(blocks.data(), sizeof(ArrowBlock), blocks.size());
+
+  builder.startTable();
+  builder.addOffset(FOOTER_SCHEMA, schema);
+  builder.addOffset(FOOTER_DICTIONARIES, dictionaries);
+  builder.addOffset(FOOTER_RECORD_BATCHES, recordBatches);
+  builder.addInt16(FOOTER_VERSION, METADATA_V5);
+  std::string footer = builder.finish(builder.endTable());
+
+  int32_t footerLength = footer.size();
+  write(footer.data(), footer.size());
+  write(&footerLength, 4);
+  write(ARROW_MAGIC, 6);
+
+  out.flush();
+}
@@ -0,0 +1,123 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef ARROWWRITER_H
+#define ARROWWRITER_H
+
+#include <string>
+#include <vector>
+
+#include "samplewriter.h"
+#include "symboltable.h"
+
+#define ARROW_BATCH_ROWS 65536
+
+/**
+ * Minimal flatbuffer builder, enough for writing Arrow IPC metadata.
+ * Like the real flatbuffers library, the buffer is built from the end
+ * towards the front, and objects are referenced by their distance from the
+ * end of the buffer.
+ */
+class FlatBuilder {
+  std::vector<uint8_t> buf;
+  std::vector<std::pair<unsigned, uint32_t> > fields;
+  uint32_t tableEnd;
+
+  void prepend(const void *data, size_t size);
+  void align(size_t size, size_t alignment);
+
+  template<typename T> void addScalar(unsigned field, T val) {
+    align(sizeof(T), sizeof(T));
+    prepend(&val, sizeof(T));
+    fields.push_back(std::make_pair(field, (uint32_t)buf.size()));
+  }
+
+public:
+  uint32_t createString(const std::string &str);
+  uint32_t createOffsetVector(const std::vector<uint32_t> &offsets);
+  /** Vector of structs, elemSize bytes each and aligned to 8 bytes */
+  uint32_t createStructVector(const void *data, size_t elemSize, size_t count);
+
+  void startTable();
+  void addUint8(unsigned field, uint8_t val) { addScalar(field, val); }
+  void addInt16(unsigned field, int16_t val) { addScalar(field, val); }
+  void addInt32(unsigned field, int32_t val) { addScalar(field, val); }
+  void addInt64(unsigned field, int64_t val) { addScalar(field, val); }
+  void addOffset(unsigned field, uint32_t offset);
+  uint32_t endTable();
+
+  /** @return The finished buffer, padded to 8 bytes */
+  std::string finish(uint32_t root);
+};
+
+struct ArrowColumn {
+  std::string name;
+  unsigned type;
+  unsigned width;
+  int dictionary;
+  std::vector<uint8_t> data;
+};
+
+/**
+ * Arrow IPC file output (Feather v2), loadable with pyarrow, pandas or polars
+ * without parsing.  There is a time column in seconds, one PC column per
+ * sampled core, current and voltage columns per active sensor, and the
+ * sample flags.  Samples are written in record batches of ARROW_BATCH_ROWS
+ * rows, and the footer with the batch index is written by finish().
+ *
+ * With a symbol table, there are also dictionary encoded function and
+ * module columns per core.  The dictionaries hold all names in the symbol
+ * table and are written once, before the first record batch.
+ */
+class ArrowWriter : public SampleWriter {
+  SymbolTable *symbols;
+  std::vector<ArrowColumn> columns;
+  unsigned rows;
+  uint64_t position;
+
+  struct ArrowBlock {
+    int64_t offset;
+    int32_t metaDataLength;
+    int32_t padding;
+    int64_t bodyLength;
+  };
+  std::vector<ArrowBlock> blocks;
+  std::vector<ArrowBlock> dictionaryBlocks;
+
+  void addColumn(std::string name, unsigned type, unsigned width, int dictionary = -1);
+  uint32_t buildSchema(FlatBuilder &builder);
+  void write(const void *data, size_t size);
+  void writePadding(size_t size);
+  ArrowBlock writeMessage(const std::string &metadata, uint64_t bodyLength);
+  void writeBatch();
+  void writeDictionary(int64_t id, const std::vector<std::string> &values);
+
+public:
+  ArrowWriter(std::ostream &out, SymbolTable *symbols = NULL) : SampleWriter(out) {
+    this->symbols = symbols;
+  }
+
+  void writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask);
+  void writeSample(struct LynsynSample *sample);
+  void finish();
+};
+
+#endif
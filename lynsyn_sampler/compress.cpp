@@ -0,0 +1,393 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <string.h>
+
+#include "compress.h"
+
+// widths of the zigzag encoded delta-of-delta, selected by a unary prefix
+static const unsigned timeWidths[] = { 0, 7, 9, 12, 32, 64 };
+#define NUM_TIME_WIDTHS (sizeof(timeWidths) / sizeof(timeWidths[0]))
+
+static uint64_t doubleBits(double d) {
+  uint64_t u;
+  memcpy(&u, &d, sizeof(u));
+  return u;
+}
+
+static double bitsDouble(uint64_t u) {
+  double d;
+  memcpy(&d, &u, sizeof(d));
+  return d;
+}
+
+static void resetXor(struct XorState *state) {
+  state->prev = 0;
+  state->leading = 32; // larger than any stored value, forces a new window
+  state->trailing = 0;
+}
+
+static void putLe(uint8_t *buf, uint64_t val, unsigned bytes) {
+  for(unsigned i = 0; i < bytes; i++) {
+    buf[i] = val >> (i * 8);
+  }
+}
+
+static uint64_t getLe(const uint8_t *buf, unsigned bytes) {
+  uint64_t val = 0;
+  for(unsigned i = 0; i < bytes; i++) {
+    val |= (uint64_t)buf[i] << (i * 8);
+  }
+  return val;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void encodeCaptureHeader(const struct CaptureHeader *header, uint8_t *buf) {
+  putLe(buf, header->magic, 4);
+  putLe(buf + 4, header->version, 2);
+  putLe(buf + 6, header->reserved, 2);
+  putLe(buf + 8, header->sensors, 4);
+  putLe(buf + 12, header->cores, 4);
+  putLe(buf + 16, header->coreMask, 8);
+}
+
+void decodeCaptureHeader(const uint8_t *buf, struct CaptureHeader *header) {
+  header->magic = getLe(buf, 4);
+  header->version = getLe(buf + 4, 2);
+  header->reserved = getLe(buf + 6, 2);
+  header->sensors = getLe(buf + 8, 4);
+  header->cores = getLe(buf + 12, 4);
+  header->coreMask = getLe(buf + 16, 8);
+}
+
+void encodeCaptureBlockHeader(const struct CaptureBlockHeader *header, uint8_t *buf) {
+  putLe(buf, header->samples, 4);
+  putLe(buf + 4, header->bytes, 4);
+}
+
+void decodeCaptureBlockHeader(const uint8_t *buf, struct CaptureBlockHeader *header) {
+  header->samples = getLe(buf, 4);
+  header->bytes = getLe(buf + 4, 4);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void BitWriter::write(uint64_t val, unsigned bits) {
+  while(bits > 0) {
+    unsigned space = 8 - accBits;
+    unsigned n = bits < space ? bits : space;
+    acc = (acc << n) | ((val >> (bits - n)) & ((1 << n) - 1));
+    accBits += n;
+    bits -= n;
+    if(accBits == 8) {
+      buf.push_back(acc);
+      acc = 0;
+      accBits = 0;
+    }
+  }
+}
+
+const std::vector<uint8_t> &BitWriter::flush() {
+  if(accBits) {
+    buf.push_back(acc << (8 - accBits));
+    acc = 0;
+    accBits = 0;
+  }
+  return buf;
+}
+
+bool BitReader::read(uint64_t *val, unsigned bits) {
+  uint64_t v = 0;
+  while(bits > 0) {
+    if(accBits == 0) {
+      if(pos >= size) return false;
+      acc = buf[pos++];
+      accBits = 8;
+    }
+    unsigned n = bits < accBits ? bits : accBits;
+    v = (v << n) | ((acc >> (accBits - n)) & ((1 << n) - 1));
+    accBits -= n;
+    bits -= n;
+  }
+  *val = v;
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+SampleEncoder::SampleEncoder(unsigned sensors) {
+  this->sensors = sensors;
+  reset();
+}
+
+void SampleEncoder::reset() {
+  samples = 0;
+  bits.clear();
+  prevTime = 0;
+  prevDelta = 0;
+  prevFlags = 0;
+  for(int i = 0; i < LYNSYN_MAX_CORES; i++) resetXor(&pc[i]);
+  for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
+    resetXor(&current[i]);
+    resetXor(&voltage[i]);
+  }
+}
+
+void SampleEncoder::encodeTime(int64_t time) {
+  int64_t delta = (uint64_t)time - (uint64_t)prevTime;
+  int64_t dod = (uint64_t)delta - (uint64_t)prevDelta;
+  uint64_t zz = ((uint64_t)dod << 1) ^ (uint64_t)(dod >> 63);
+
+  prevTime = time;
+  prevDelta = delta;
+
+  for(unsigned i = 0; i < NUM_TIME_WIDTHS; i++) {
+    unsigned width = timeWidths[i];
+    if((width == 64) || (zz < (1ull << width))) {
+      // unary prefix: i ones, terminated by a zero unless this is the last width
+      bits.write((1ull << i) - 1, i);
+      if(i < NUM_TIME_WIDTHS - 1) bits.write(0, 1);
+      if(width) bits.write(zz, width);
+      return;
+    }
+  }
+}
+
+void SampleEncoder::encodeXor(struct XorState *state, uint64_t val) {
+  uint64_t x = val ^ state->prev;
+  state->prev = val;
+
+  if(!x) {
+    bits.write(0, 1);
+    return;
+  }
+  bits.write(1, 1);
+
+  unsigned leading = __builtin_clzll(x);
+  unsigned trailing = __builtin_ctzll(x);
+  if(leading > 31) leading = 31;
+
+  if((leading >= state->leading) && (trailing >= state->trailing)) {
+    // fits in previous window
+    bits.write(0, 1);
+    bits.write(x >> state->trailing, 64 - state->leading - state->trailing);
+
+  } else {
+    unsigned len = 64 - leading - trailing;
+    bits.write(1, 1);
+    bits.write(leading, 5);
+    bits.write(len - 1, 6);
+    bits.write(x >> trailing, len);
+    state->leading = leading;
+    state->trailing = trailing;
+  }
+}
+
+void SampleEncoder::add(struct LynsynSample *sample) {
+  encodeTime(sample->time);
+
+  for(int core = 0; core < LYNSYN_MAX_CORES; core++) {
+    encodeXor(&pc[core], sample->pc[core]);
+  }
+
+  for(unsigned sensor = 0; sensor < sensors; sensor++) {
+    encodeXor(&current[sensor], doubleBits(sample->current[sensor]));
+    encodeXor(&voltage[sensor], doubleBits(sample->voltage[sensor]));
+  }
+
+  if(sample->flags == prevFlags) {
+    bits.write(0, 1);
+  } else {
+    bits.write(1, 1);
+    bits.write(sample->flags, 16);
+    prevFlags = sample->flags;
+  }
+
+  samples++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+SampleDecoder::SampleDecoder(unsigned sensors) {
+  this->sensors = sensors;
+  reset();
+}
+
+void SampleDecoder::reset() {
+  prevTime = 0;
+  prevDelta = 0;
+  prevFlags = 0;
+  for(int i = 0; i < LYNSYN_MAX_CORES; i++) resetXor(&pc[i]);
+  for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
+    resetXor(&current[i]);
+    resetXor(&voltage[i]);
+  }
+}
+
+bool SampleDecoder::decodeTime(BitReader *bits, int64_t *time) {
+  unsigned i = 0;
+  uint64_t bit;
+
+  while(i < NUM_TIME_WIDTHS - 1) {
+    if(!bits->read(&bit, 1)) return false;
+    if(!bit) break;
+    i++;
+  }
+
+  uint64_t zz = 0;
+  if(timeWidths[i]) {
+    if(!bits->read(&zz, timeWidths[i])) return false;
+  }
+
+  int64_t dod = (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+  int64_t delta = (uint64_t)prevDelta + (uint64_t)dod;
+  *time = (uint64_t)prevTime + (uint64_t)delta;
+
+  prevTime = *time;
+  prevDelta = delta;
+
+  return true;
+}
+
+bool SampleDecoder::decodeXor(BitReader *bits, struct XorState *state, uint64_t *val) {
+  uint64_t bit;
+
+  if(!bits->read(&bit, 1)) return false;
+
+  if(bit) {
+    uint64_t x;
+
+    if(!bits->read(&bit, 1)) return false;
+
+    if(!bit) {
+      if(!bits->read(&x, 64 - state->leading - state->trailing)) return false;
+      x <<= state->trailing;
+
+    } else {
+      uint64_t leading, len;
+      if(!bits->read(&leading, 5)) return false;
+      if(!bits->read(&len, 6)) return false;
+      len++;
+      if(!bits->read(&x, len)) return false;
+      state->leading = leading;
+      state->trailing = 64 - leading - len;
+      x <<= state->trailing;
+    }
+
+    state->prev ^= x;
+  }
+
+  *val = state->prev;
+
+  return true;
+}
+
+bool SampleDecoder::decodeBlock(const uint8_t *buf, size_t size, unsigned samples, std::vector<struct LynsynSample> &out) {
+  BitReader bits(buf, size);
+
+  reset();
+
+  for(unsigned i = 0; i < samples; i++) {
+    struct LynsynSample sample;
+    uint64_t val;
+
+    if(!decodeTime(&bits, &sample.time)) return false;
+
+    for(int core = 0; core < LYNSYN_MAX_CORES; core++) {
+      if(!decodeXor(&bits, &pc[core], &sample.pc[core])) return false;
+    }
+
+    for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
+      if(sensor < sensors) {
+        if(!decodeXor(&bits, &current[sensor], &val)) return false;
+        sample.current[sensor] = bitsDouble(val);
+        if(!decodeXor(&bits, &voltage[sensor], &val)) return false;
+        sample.voltage[sensor] = bitsDouble(val);
+      } else {
+        sample.current[sensor] = 0;
+        sample.voltage[sensor] = 0;
+      }
+    }
+
+    if(!bits.read(&val, 1)) return false;
+    if(val) {
+      if(!bits.read(&val, 16)) return false;
+      prevFlags = val;
+    }
+    sample.flags = prevFlags;
+
+    out.push_back(sample);
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+CaptureReader::CaptureReader() {
+  fp = NULL;
+  decoder = NULL;
+  blockPos = 0;
+}
+
+CaptureReader::~CaptureReader() {
+  if(fp) fclose(fp);
+  delete decoder;
+}
+
+bool CaptureReader::open(const char *filename) {
+  fp = fopen(filename, "rb");
+  if(!fp) return false;
+
+  uint8_t buf[CAPTURE_HEADER_SIZE];
+  if(fread(buf, sizeof(buf), 1, fp) != 1) return false;
+  decodeCaptureHeader(buf, &header);
+
+  if(header.magic != CAPTURE_MAGIC) return false;
+  if(header.version != CAPTURE_VERSION) return false;
+  if(header.sensors > LYNSYN_MAX_SENSORS) return false;
+
+  decoder = new SampleDecoder(header.sensors);
+
+  return true;
+}
+
+bool CaptureReader::next(struct LynsynSample *sample) {
+  while(blockPos >= block.size()) {
+    uint8_t headerBuf[CAPTURE_BLOCK_HEADER_SIZE];
+    if(fread(headerBuf, sizeof(headerBuf), 1, fp) != 1) return false;
+
+    struct CaptureBlockHeader blockHeader;
+    decodeCaptureBlockHeader(headerBuf, &blockHeader);
+
+    std::vector<uint8_t> buf(blockHeader.bytes);
+    if(blockHeader.bytes && (fread(buf.data(), blockHeader.bytes, 1, fp) != 1)) return false;
+
+    block.clear();
+    blockPos = 0;
+    if(!decoder->decodeBlock(buf.data(), buf.size(), blockHeader.samples, block)) return false;
+  }
+
+  *sample = block[blockPos++];
+
+  return true;
+}
@@ -0,0 +1,181 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef COMPRESS_H
+#define COMPRESS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include <lynsyn.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Compressed capture file format
+//
+// A CaptureHeader followed by any number of blocks.  Each block is a
+// CaptureBlockHeader followed by a bitstream of encoded samples.  The encoder
+// state is reset for each block, so a truncated file can be decoded up to the
+// last complete block.
+//
+// Per sample:
+//   time:    delta-of-delta, variable length
+//   pc:      XOR against previous PC of the same core (repeated PC = 1 bit)
+//   current: XOR against previous value of the same sensor (Gorilla)
+//   voltage: XOR against previous value of the same sensor (Gorilla)
+//   flags:   1 bit if unchanged, otherwise 1+16 bits
+//
+// The headers are stored little endian, field by field without padding, see
+// encodeCaptureHeader().  The bitstream is written most significant bit
+// first, so it does not depend on the host byte order either.
+
+#define CAPTURE_MAGIC 0x434e594c // "LYNC"
+#define CAPTURE_VERSION 1
+#define CAPTURE_BLOCK_SAMPLES 4096
+
+#define CAPTURE_HEADER_SIZE 24
+#define CAPTURE_BLOCK_HEADER_SIZE 8
+
+struct CaptureHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t sensors;
+  uint32_t cores;
+  uint64_t coreMask;
+};
+
+struct CaptureBlockHeader {
+  uint32_t samples;
+  uint32_t bytes;
+};
+
+void encodeCaptureHeader(const struct CaptureHeader *header, uint8_t *buf);
+void decodeCaptureHeader(const uint8_t *buf, struct CaptureHeader *header);
+void encodeCaptureBlockHeader(const struct CaptureBlockHeader *header, uint8_t *buf);
+void decodeCaptureBlockHeader(const uint8_t *buf, struct CaptureBlockHeader *header);
+
+///////////////////////////////////////////////////////////////////////////////
+
+class BitWriter {
+  std::vector<uint8_t> buf;
+  uint64_t acc;
+  unsigned accBits;
+
+public:
+  BitWriter() { clear(); }
+  void clear() {
+    buf.clear();
+    acc = 0;
+    accBits = 0;
+  }
+  void write(uint64_t val, unsigned bits);
+  const std::vector<uint8_t> &flush();
+};
+
+class BitReader {
+  const uint8_t *buf;
+  size_t size;
+  size_t pos;
+  uint64_t acc;
+  unsigned accBits;
+
+public:
+  BitReader(const uint8_t *buf, size_t size) {
+    this->buf = buf;
+    this->size = size;
+    pos = 0;
+    acc = 0;
+    accBits = 0;
+  }
+  bool read(uint64_t *val, unsigned bits);
+};
+
+struct XorState {
+  uint64_t prev;
+  unsigned leading;
+  unsigned trailing;
+};
+
+class SampleEncoder {
+  unsigned sensors;
+  unsigned samples;
+  BitWriter bits;
+
+  int64_t prevTime;
+  int64_t prevDelta;
+  uint16_t prevFlags;
+  struct XorState pc[LYNSYN_MAX_CORES];
+  struct XorState current[LYNSYN_MAX_SENSORS];
+  struct XorState voltage[LYNSYN_MAX_SENSORS];
+
+  void encodeTime(int64_t time);
+  void encodeXor(struct XorState *state, uint64_t val);
+
+public:
+  SampleEncoder(unsigned sensors);
+
+  void reset();
+  void add(struct LynsynSample *sample);
+  unsigned numSamples() { return samples; }
+  const std::vector<uint8_t> &flush() { return bits.flush(); }
+};
+
+class SampleDecoder {
+  unsigned sensors;
+
+  int64_t prevTime;
+  int64_t prevDelta;
+  uint16_t prevFlags;
+  struct XorState pc[LYNSYN_MAX_CORES];
+  struct XorState current[LYNSYN_MAX_SENSORS];
+  struct XorState voltage[LYNSYN_MAX_SENSORS];
+
+  bool decodeTime(BitReader *bits, int64_t *time);
+  bool decodeXor(BitReader *bits, struct XorState *state, uint64_t *val);
+
+public:
+  SampleDecoder(unsigned sensors);
+
+  void reset();
+  bool decodeBlock(const uint8_t *buf, size_t size, unsigned samples, std::vector<struct LynsynSample> &out);
+};
+
+///////////////////////////////////////////////////////////////////////////////
+
+/** Reads samples back from a compressed capture file */
+class CaptureReader {
+  FILE *fp;
+  SampleDecoder *decoder;
+  std::vector<struct LynsynSample> block;
+  unsigned blockPos;
+
+public:
+  struct CaptureHeader header;
+
+  CaptureReader();
+  ~CaptureReader();
+
+  bool open(const char *filename);
+  bool next(struct LynsynSample *sample);
+};
+
+#endif
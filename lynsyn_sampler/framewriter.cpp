@@ -0,0 +1,97 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <iomanip>
+
+#include "framewriter.h"
+
+void FrameWriter::startFrame(int64_t time) {
+  frameStart = time;
+  lastTime = time;
+  for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
+    energy[i] = 0;
+    peakPower[i] = 0;
+  }
+}
+
+void FrameWriter::writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask) {
+  SampleWriter::writeHeader(sensors, cores, coreMask);
+  if(writer) writer->writeHeader(sensors, cores, coreMask);
+
+  frames = 0;
+  frameStart = -1;
+
+  out << "Frame;Start;Duration";
+  for(unsigned sensor = 0; sensor < sensors; sensor++) {
+    out << ";energy " << sensor;
+  }
+  for(unsigned sensor = 0; sensor < sensors; sensor++) {
+    out << ";peak " << sensor;
+  }
+  out << "\n";
+  out << std::setprecision(9) << std::fixed;
+}
+
+void FrameWriter::writeSample(struct LynsynSample *sample) {
+  if(writer) writer->writeSample(sample);
+
+  if(sample->flags & SAMPLE_FLAG_GAP) {
+    // not a frame boundary, but nothing was sampled until pc[0]
+    if(frameStart != -1) lastTime = sample->pc[0];
+
+  } else if(sample->flags & SAMPLE_FLAG_MARK) {
+    if(frameStart != -1) {
+      out << frames << ";" << lynsyn_cyclesToSeconds(frameStart) << ";" << lynsyn_cyclesToSeconds(sample->time - frameStart);
+      for(unsigned sensor = 0; sensor < sensors; sensor++) {
+        out << ";" << energy[sensor];
+      }
+      for(unsigned sensor = 0; sensor < sensors; sensor++) {
+        out << ";" << peakPower[sensor];
+      }
+      out << "\n";
+      frames++;
+    }
+
+    // pc[0] holds the time the target resumed after the mark breakpoint
+    startFrame(sample->pc[0]);
+
+  } else {
+    if(frameStart == -1) startFrame(sample->time);
+
+    double seconds = lynsyn_cyclesToSeconds(sample->time - lastTime);
+    lastTime = sample->time;
+
+    for(unsigned sensor = 0; sensor < sensors; sensor++) {
+      double power = sample->current[sensor] * sample->voltage[sensor];
+      energy[sensor] += power * seconds;
+      if(power > peakPower[sensor]) peakPower[sensor] = power;
+    }
+  }
+}
+
+void FrameWriter::finish() {
+  if(writer) writer->finish();
+  out.flush();
+
+  printf("%u frames\n", frames);
+  fflush(stdout);
+}
@@ -0,0 +1,57 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef FRAMEWRITER_H
+#define FRAMEWRITER_H
+
+#include "samplewriter.h"
+
+/**
+ * Per frame energy accounting.  Every mark sample closes a frame, and one
+ * line with frame duration, energy and peak power per sensor is written to
+ * the output stream.  Samples are passed on to the wrapped writer, unless it
+ * is NULL.
+ */
+class FrameWriter : public SampleWriter {
+  SampleWriter *writer;
+
+  unsigned frames;
+  int64_t frameStart;
+  int64_t lastTime;
+  double energy[LYNSYN_MAX_SENSORS];
+  double peakPower[LYNSYN_MAX_SENSORS];
+
+  void startFrame(int64_t time);
+
+public:
+  FrameWriter(std::ostream &out, SampleWriter *writer) : SampleWriter(out) {
+    this->writer = writer;
+  }
+  ~FrameWriter() {
+    delete writer;
+  }
+
+  void writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask);
+  void writeSample(struct LynsynSample *sample);
+  void finish();
+};
+
+#endif
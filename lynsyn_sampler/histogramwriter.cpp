@@ -0,0 +1,111 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <vector>
+#include <algorithm>
+#include <iomanip>
+
+#include "histogramwriter.h"
+
+typedef std::pair<uint64_t, struct PcEntry> PcLine;
+
+static bool moreSamples(const PcLine &a, const PcLine &b) {
+  return a.second.samples > b.second.samples;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void HistogramWriter::writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask) {
+  SampleWriter::writeHeader(sensors, cores, coreMask);
+
+  lastTime = -1;
+  for(int core = 0; core < LYNSYN_MAX_CORES; core++) {
+    entries[core].clear();
+  }
+}
+
+void HistogramWriter::writeSample(struct LynsynSample *sample) {
+  if(sample->flags & (SAMPLE_FLAG_MARK | SAMPLE_FLAG_GAP)) {
+    // halted at a mark or not sampled, pc[0] is when sampling resumed
+    lastTime = sample->pc[0];
+    return;
+  }
+
+  int64_t timeSinceLast = 0;
+  if(lastTime != -1) timeSinceLast = sample->time - lastTime;
+  lastTime = sample->time;
+
+  double seconds = lynsyn_cyclesToSeconds(timeSinceLast);
+
+  for(int core = 0; core < LYNSYN_MAX_CORES; core++) {
+    if(coreMask & (1 << core)) {
+      std::unordered_map<uint64_t, struct PcEntry>::iterator it = entries[core].find(sample->pc[core]);
+      if(it == entries[core].end()) {
+        struct PcEntry entry;
+        entry.samples = 0;
+        entry.time = 0;
+        for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) entry.energy[i] = 0;
+        it = entries[core].insert(std::make_pair(sample->pc[core], entry)).first;
+      }
+
+      struct PcEntry *entry = &it->second;
+      entry->samples++;
+      entry->time += timeSinceLast;
+      for(unsigned sensor = 0; sensor < sensors; sensor++) {
+        entry->energy[sensor] += sample->current[sensor] * sample->voltage[sensor] * seconds;
+      }
+    }
+  }
+}
+
+void HistogramWriter::finish() {
+  out << "Sensors;Cores\n";
+  out << sensors << ";" << cores << "\n";
+
+  out << "Core;PC;Samples;Time";
+  for(unsigned sensor = 0; sensor < sensors; sensor++) {
+    out << ";energy " << sensor;
+  }
+  if(symbols) out << ";Function;Module";
+  out << "\n";
+
+  out << std::setprecision(9) << std::fixed;
+
+  for(int core = 0; core < LYNSYN_MAX_CORES; core++) {
+    std::vector<PcLine> lines(entries[core].begin(), entries[core].end());
+    std::sort(lines.begin(), lines.end(), moreSamples);
+
+    for(auto line : lines) {
+      out << core << ";" << line.first << ";" << line.second.samples << ";" << lynsyn_cyclesToSeconds(line.second.time);
+      for(unsigned sensor = 0; sensor < sensors; sensor++) {
+        out << ";" << line.second.energy[sensor];
+      }
+      if(symbols) {
+        const struct Symbol *symbol = symbols->lookup(line.first);
+        out << ";" << symbols->functionNames()[symbol ? symbol->name : SYMBOL_UNKNOWN];
+        out << ";" << symbols->moduleNames()[symbol ? symbol->module : SYMBOL_UNKNOWN];
+      }
+      out << "\n";
+    }
+  }
+
+  out.flush();
+}
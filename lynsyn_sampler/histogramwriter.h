@@ -0,0 +1,57 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef HISTOGRAMWRITER_H
+#define HISTOGRAMWRITER_H
+
+#include <unordered_map>
+
+#include "samplewriter.h"
+#include "symboltable.h"
+
+struct PcEntry {
+  uint64_t samples;
+  int64_t time;
+  double energy[LYNSYN_MAX_SENSORS];
+};
+
+/**
+ * Accumulates hit count, time and energy per (core, PC) while sampling, and
+ * writes the flat table when sampling has finished.  Output size depends on
+ * the number of distinct PCs and not on the length of the run.  With a
+ * symbol table, the function and module of each PC are added.
+ */
+class HistogramWriter : public SampleWriter {
+  SymbolTable *symbols;
+  std::unordered_map<uint64_t, struct PcEntry> entries[LYNSYN_MAX_CORES];
+  int64_t lastTime;
+
+public:
+  HistogramWriter(std::ostream &out, SymbolTable *symbols = NULL) : SampleWriter(out) {
+    this->symbols = symbols;
+  }
+
+  void writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask);
+  void writeSample(struct LynsynSample *sample);
+  void finish();
+};
+
+#endif
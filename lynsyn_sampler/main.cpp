@@ -27,39 +27,68 @@
 #include <iostream>
 #include <iomanip>
 #include <inttypes.h>
+#include <signal.h>
+#include <vector>
+#include <chrono>
+#include <ctype.h>
+#include <algorithm>
 
 #include <lynsyn.h>
 
+#include "samplewriter.h"
+#include "compress.h"
+#include "tracewriter.h"
+#include "arrowwriter.h"
+#include "summarywriter.h"
+#include "histogramwriter.h"
+#include "triggerwriter.h"
+#include "framewriter.h"
+#include "outputsink.h"
+#include "rotatingwriter.h"
+#include "symboltable.h"
+
+#define FLUSH_NONE -1
+#define FLUSH_AUTO -2
+#define FLUSH_AUTO_INTERVAL 100
+
+#define LOW_JITTER_PRIORITY 50
+
+// continuous sampling is done in back to back periods of this length.  A
+// stop waits for the rest of the current period, so it is kept short
+#define CONTINUOUS_PERIOD 1
+
 #ifdef _WIN32
 #define LONGLONGHEX "I64x"
 #else
 #define LONGLONGHEX PRIx64
 #endif
 
-struct TraceHeader {
-  uint32_t magic;
-  uint32_t stream_id;
-};
-
-struct TraceEvent {
-  uint32_t id;
-  uint64_t timestamp;
-
-  uint64_t pc[4];
-  double current[3];
-  double voltage[3];
-};
-
 static char doc[] = "A sampling tool for Lynsyn boards";
 static char args_doc[] = "";
 
 static struct argp_option options[] = {
   {"cores",     'c', "cores",     0, "Cores to sample" },
-  {"startaddr", 's', "startaddr", 0, "Start Address" },
-  {"endaddr",   'e', "endaddr",   0, "End Address" },
-  {"frameaddr", 'f', "frameaddr", 0, "Frame Address" },
-  {"duration",  'd', "duration",  0, "Duration" },
-  {"output",    'o', "filename",  0, "Output File" },
+  {"startaddr", 's', "startaddr", 0, "Start Address, or a function name when --elf is given" },
+  {"endaddr",   'e', "endaddr",   0, "End Address, or a function name when --elf is given" },
+  {"frameaddr", 'f', "frameaddr", 0, "Frame Address, or a function name when --elf is given" },
+  {"duration",  'd', "duration",  0, "Duration in seconds, fractions allowed.  0 samples until interrupted by SIGINT or SIGTERM" },
+  {"output",    'o', "filename",  0, "Output File.  Use - for stdout and unix:<path> for a Unix socket" },
+  {"format",    'F', "format",    0, "Output format: csv (default), compressed, arrow, perfetto, summary or histogram" },
+  {"input",     'i', "filename",  0, "Read samples from a compressed capture instead of the Lynsyn board" },
+  {"trigger",   't', "condition", 0, "Only write samples around trigger events.  Condition is mark, signal (SIGUSR1), <watts> or <sensor>:<watts>.  Can be given multiple times" },
+  {"pretrigger",  'P', "seconds", 0, "Seconds of samples kept before a trigger (default 1)" },
+  {"posttrigger", 'A', "seconds", 0, "Seconds of samples written after a trigger (default 1)" },
+  {"frames",    'R', "filename",  0, "Write per frame duration, energy and peak power (default frames.csv when a frame address is given)" },
+  {"noraw",     'n', 0,           0, "Do not write samples, only per frame results" },
+  {"flush",     'u', "policy",    0, "When to flush output: none, sample, or an interval in ms (default 100 for stdout, pipes and sockets, none for files)" },
+  {"backpressure", 'B', "policy",  0, "What to do when a pipe or socket reader falls behind: block (default) or drop samples" },
+  {"rotatesize", 'S', "bytes",     0, "Start a new output file when the current one reaches this size, checked every 1024 samples.  Suffixes k, M and G are accepted" },
+  {"rotatetime", 'T', "seconds",   0, "Start a new output file after this many seconds of samples" },
+  {"keep",       'K', "files",     0, "Number of rotated output files to keep, older files are deleted (default all)" },
+  {"elf",        'E', "filename",  0, "ELF file used for symbolizing PCs in perfetto, histogram and arrow output.  Can be given multiple times" },
+  {"kallsyms",   'k', "filename",  0, "kallsyms file used for symbolizing PCs" },
+  {"plan",       'p', "filename",  0, "Run all captures listed in the file, one line of options per capture, with a single board initialisation" },
+  {"lowjitter",  'L', "cpu",       OPTION_ARG_OPTIONAL, "Low jitter mode: real-time scheduling, locked memory and optionally pinned to the given CPU.  Reports USB transfer timing when done" },
   { 0 }
 };
 
@@ -70,10 +99,85 @@ struct arguments {
   uint64_t startAddr;
   uint64_t endAddr;
   uint64_t frameAddr;
+  std::string startSymbol;
+  std::string endSymbol;
+  std::string frameSymbol;
   double duration;
   std::string output;
+  std::string format;
+  std::string input;
+  std::string plan;
+  std::vector<std::string> elfFiles;
+  std::vector<std::string> kallsyms;
+  std::vector<struct TriggerCondition> triggers;
+  double preTrigger;
+  double postTrigger;
+  std::string frames;
+  bool noRaw;
+  int flushInterval;
+  bool dropSamples;
+  uint64_t rotateSize;
+  double rotateTime;
+  unsigned keep;
+  bool lowJitter;
+  int lowJitterCpu;
 };
 
+static bool parseSize(char *arg, uint64_t *size) {
+  char *end;
+
+  *size = strtoull(arg, &end, 0);
+  if(end == arg) return false;
+
+  switch(*end) {
+    case 'k': case 'K': *size <<= 10; end++; break;
+    case 'm': case 'M': *size <<= 20; end++; break;
+    case 'g': case 'G': *size <<= 30; end++; break;
+  }
+
+  return !*end;
+}
+
+/** Parses a number, or keeps the string as a symbol name to resolve later */
+static void parseAddress(char *arg, uint64_t *addr, std::string *symbol) {
+  char *end;
+  *addr = strtoull(arg, &end, 0);
+  if((end == arg) || *end) {
+    *addr = 0;
+    *symbol = arg;
+  } else {
+    symbol->clear();
+  }
+}
+
+static bool parseTrigger(char *arg, struct TriggerCondition *condition) {
+  char *end;
+
+  condition->sensor = -1;
+  condition->power = 0;
+
+  if(!strcmp(arg, "mark")) {
+    condition->type = TriggerCondition::MARK;
+    return true;
+  }
+  if(!strcmp(arg, "signal")) {
+    condition->type = TriggerCondition::SIGNAL;
+    return true;
+  }
+
+  condition->type = TriggerCondition::POWER;
+
+  char *colon = strchr(arg, ':');
+  if(colon) {
+    condition->sensor = strtol(arg, &end, 0) - 1;
+    if((end != colon) || (condition->sensor < 0) || (condition->sensor >= LYNSYN_MAX_SENSORS)) return false;
+    arg = colon + 1;
+  }
+
+  condition->power = strtod(arg, &end);
+  return (end != arg) && !*end;
+}
+
 static error_t parse_opt(int key, char *arg, struct argp_state *state) {
   struct arguments *arguments = (struct arguments*)state->input;
 
@@ -85,22 +189,78 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
       arguments->useBp = true;
       break;
     case 's':
-      arguments->startAddr = strtol(arg, NULL, 0);
+      parseAddress(arg, &arguments->startAddr, &arguments->startSymbol);
       arguments->useBp = true;
       break;
     case 'e':
-      arguments->endAddr = strtol(arg, NULL, 0);
+      parseAddress(arg, &arguments->endAddr, &arguments->endSymbol);
       break;
     case 'f':
-      arguments->frameAddr = strtol(arg, NULL, 0);
+      parseAddress(arg, &arguments->frameAddr, &arguments->frameSymbol);
       arguments->useFrameBp = true;
       break;
     case 'd':
-      arguments->duration = strtol(arg, NULL, 0);
+      arguments->duration = strtod(arg, NULL);
       break;
     case 'o':
       arguments->output = arg;
       break;
+    case 'F':
+      arguments->format = arg;
+      break;
+    case 'i':
+      arguments->input = arg;
+      break;
+    case 'p':
+      arguments->plan = arg;
+      break;
+    case 'E':
+      arguments->elfFiles.push_back(arg);
+      break;
+    case 'k':
+      arguments->kallsyms.push_back(arg);
+      break;
+    case 't': {
+      struct TriggerCondition condition;
+      if(!parseTrigger(arg, &condition)) argp_error(state, "Invalid trigger condition '%s'", arg);
+      arguments->triggers.push_back(condition);
+      break;
+    }
+    case 'P':
+      arguments->preTrigger = strtod(arg, NULL);
+      break;
+    case 'A':
+      arguments->postTrigger = strtod(arg, NULL);
+      break;
+    case 'R':
+      arguments->frames = arg;
+      break;
+    case 'n':
+      arguments->noRaw = true;
+      break;
+    case 'u':
+      if(!strcmp(arg, "none")) arguments->flushInterval = FLUSH_NONE;
+      else if(!strcmp(arg, "sample")) arguments->flushInterval = 0;
+      else arguments->flushInterval = strtol(arg, NULL, 0);
+      break;
+    case 'B':
+      if(!strcmp(arg, "block")) arguments->dropSamples = false;
+      else if(!strcmp(arg, "drop")) arguments->dropSamples = true;
+      else argp_error(state, "Invalid backpressure policy '%s'", arg);
+      break;
+    case 'S':
+      if(!parseSize(arg, &arguments->rotateSize)) argp_error(state, "Invalid size '%s'", arg);
+      break;
+    case 'T':
+      arguments->rotateTime = strtod(arg, NULL);
+      break;
+    case 'K':
+      arguments->keep = strtol(arg, NULL, 0);
+      break;
+    case 'L':
+      arguments->lowJitter = true;
+      if(arg) arguments->lowJitterCpu = strtol(arg, NULL, 0);
+      break;
 
     case ARGP_KEY_ARG:
       if (state->arg_num >= 0)
@@ -115,6 +275,432 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state) {
 
 static struct argp argp = { options, parse_opt, args_doc, doc };
 
+static CaptureReader *captureReader = NULL;
+static volatile sig_atomic_t stopRequested = 0;
+
+static struct {
+  bool enabled;
+  uint64_t cores;
+  int64_t timeOffset;
+  int64_t lastTime;
+  int64_t lastInterval;
+  bool pending;
+  struct LynsynSample pendingSample;
+} continuous;
+static SymbolTable *symbols = NULL;
+
+#ifndef _WIN32
+static void triggerHandler(int sig) {
+  TriggerWriter::externalTrigger = 1;
+}
+#endif
+
+static void stopHandler(int sig) {
+  stopRequested = 1;
+  // a second signal terminates immediately
+  signal(sig, SIG_DFL);
+}
+
+static bool getNextSample(struct LynsynSample *sample) {
+  if(stopRequested) return false;
+
+  if(captureReader) return captureReader->next(sample);
+
+  if(continuous.pending) {
+    *sample = continuous.pendingSample;
+    continuous.pending = false;
+    return true;
+  }
+
+  bool restarted = false;
+
+  while(!lynsyn_getNextSample(sample)) {
+    if(!continuous.enabled || stopRequested) return false;
+
+    // a period that gives no samples at all means the board or the USB
+    // transfer failed, not that the period ended
+    if(restarted) {
+      printf("No samples after restarting, stopping\n");
+      fflush(stdout);
+      return false;
+    }
+
+    // the period has ended, start the next one right away
+    lynsyn_continuePeriodSampling(CONTINUOUS_PERIOD, continuous.cores);
+    restarted = true;
+  }
+
+  if(continuous.enabled) {
+    // keep time increasing if the board restarted its time base
+    if(restarted && (sample->time + continuous.timeOffset <= continuous.lastTime)) {
+      continuous.timeOffset = continuous.lastTime + continuous.lastInterval - sample->time;
+    }
+    sample->time += continuous.timeOffset;
+
+    int64_t lastTime = continuous.lastTime;
+
+    if(lastTime != -1) continuous.lastInterval = sample->time - lastTime;
+    continuous.lastTime = sample->time;
+
+    // samples are lost while the board restarts.  The gap from the last
+    // sample to this one is reported first, and this sample is returned on
+    // the next call
+    if(restarted && (lastTime != -1)) {
+      continuous.pendingSample = *sample;
+      continuous.pending = true;
+
+      memset(sample, 0, sizeof(struct LynsynSample));
+      sample->flags = SAMPLE_FLAG_GAP;
+      sample->time = lastTime;
+      sample->pc[0] = continuous.pendingSample.time;
+    }
+  }
+
+  return true;
+}
+
+static SampleWriter *createWriter(std::string format, std::ostream &out) {
+  if(format == "csv") return new CsvWriter(out);
+  if(format == "compressed") return new CompressedWriter(out);
+  if(format == "arrow") return new ArrowWriter(out, symbols);
+  if(format == "perfetto") return new TraceWriter(out, symbols);
+  if(format == "summary") return new SummaryWriter(out);
+  if(format == "histogram") return new HistogramWriter(out, symbols);
+  return NULL;
+}
+
+static void printTransferStats() {
+  struct LynsynTransferStats stats;
+  bool timed = lynsyn_getTransferStats(&stats);
+
+  printf("USB transfers: %" PRIu64 " (%" PRIu64 " samples)\n", stats.transfers, stats.samples);
+  if(!timed || (stats.transfers < 2)) return;
+
+  printf("Transfer interval: min %.1fus mean %.1fus max %.1fus\n",
+         stats.minInterval * 1e6, stats.meanInterval * 1e6, stats.maxInterval * 1e6);
+
+  for(unsigned i = 0; i < LYNSYN_TRANSFER_BUCKETS; i++) {
+    if(!stats.histogram[i]) continue;
+
+    if(i == 0) printf("  %10s < %8uus", "", 1);
+    else if(i == LYNSYN_TRANSFER_BUCKETS - 1) printf("  %10s >= %7uus", "", 1u << (i - 1));
+    else printf("  %8uus - %8uus", 1u << (i - 1), 1u << i);
+
+    printf(": %" PRIu64 "\n", stats.histogram[i]);
+  }
+}
+
+static bool writeSamples(struct arguments *arguments, unsigned sensors, unsigned cores, uint64_t coreMask) {
+  OutputSink output;
+  OutputSink framesOutput;
+  SampleWriter *writer = NULL;
+
+  if(!arguments->noRaw) {
+    bool rotate = arguments->rotateSize || (arguments->rotateTime > 0);
+    std::string name = arguments->output;
+    if(rotate) name = RotatingWriter::fileName(arguments->output, 0);
+
+    if(!output.open(name, arguments->format != "csv", !arguments->dropSamples)) {
+      printf("Can't open output file\n");
+      return false;
+    }
+
+    if(rotate && output.isStream()) {
+      printf("Output rotation needs a regular output file\n");
+      return false;
+    }
+
+    writer = createWriter(arguments->format, output.out());
+    if(!writer) {
+      printf("Unknown output format %s\n", arguments->format.c_str());
+      return false;
+    }
+
+    if(rotate) {
+      writer = new RotatingWriter(writer, &output, arguments->output, arguments->rotateSize, arguments->rotateTime, arguments->keep);
+    }
+
+    if(!arguments->triggers.empty()) {
+      writer = new TriggerWriter(writer, arguments->triggers, arguments->preTrigger, arguments->postTrigger);
+    }
+  }
+
+  if(!arguments->frames.empty()) {
+    if(!framesOutput.open(arguments->frames, false, !arguments->dropSamples)) {
+      printf("Can't open frames file\n");
+      delete writer;
+      return false;
+    }
+
+    writer = new FrameWriter(framesOutput.out(), writer);
+  }
+
+  if(!writer) {
+    printf("No output selected\n");
+    return false;
+  }
+
+  int flushInterval = arguments->flushInterval;
+  if(flushInterval == FLUSH_AUTO) {
+    flushInterval = (output.isStream() || framesOutput.isStream()) ? FLUSH_AUTO_INTERVAL : FLUSH_NONE;
+  }
+
+  std::chrono::steady_clock::time_point lastFlush = std::chrono::steady_clock::now();
+  uint64_t dropped = 0;
+
+  writer->writeHeader(sensors, cores, coreMask);
+
+  struct LynsynSample sample;
+  while(getNextSample(&sample)) {
+    if(arguments->dropSamples && (output.backlog() > OUTPUT_MAX_BACKLOG)) {
+      output.out().flush();
+      if(output.backlog() > OUTPUT_MAX_BACKLOG) {
+        dropped++;
+        continue;
+      }
+    }
+
+    writer->writeSample(&sample);
+
+    if(flushInterval != FLUSH_NONE) {
+      std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+      if(now - lastFlush >= std::chrono::milliseconds(flushInterval)) {
+        if(!arguments->noRaw) output.out().flush();
+        if(!arguments->frames.empty()) framesOutput.out().flush();
+        lastFlush = now;
+      }
+    }
+
+    if((!arguments->noRaw && output.failed()) || (!arguments->frames.empty() && framesOutput.failed())) {
+      printf("Output closed by reader\n");
+      break;
+    }
+  }
+
+  if(stopRequested) printf("Interrupted, finishing output\n");
+
+  writer->finish();
+  delete writer;
+
+  if(dropped) printf("%" PRIu64 " samples dropped because the reader was too slow\n", dropped);
+
+  return true;
+}
+
+static void convertCapture(struct arguments *arguments) {
+  printf("Converting %s\n", arguments->input.c_str());
+  printf("Output file: %s\n", arguments->output.c_str());
+  fflush(stdout);
+
+  captureReader = new CaptureReader();
+  if(captureReader->open(arguments->input.c_str())) {
+    writeSamples(arguments, captureReader->header.sensors, captureReader->header.cores, captureReader->header.coreMask);
+  } else {
+    printf("Can't open input file\n");
+  }
+  delete captureReader;
+  captureReader = NULL;
+
+  fflush(stdout);
+}
+
+static void sample(struct arguments *arguments) {
+  if(arguments->useBp) {
+    printf("Sampling PC and power\n");
+    printf("From breakpoint %" LONGLONGHEX " to breakpoint %" LONGLONGHEX, arguments->startAddr, arguments->endAddr);
+    if(arguments->useFrameBp) printf(" using frame breakpoint %" LONGLONGHEX "\n", arguments->frameAddr);
+    else printf("\n");
+    printf("Maximum duration %fs\n", arguments->duration);
+    printf("Output file: %s\n", arguments->output.c_str());
+    if(!arguments->frames.empty()) printf("Frames file: %s\n", arguments->frames.c_str());
+
+  } else {
+    printf("Sampling power\n");
+    if(arguments->duration > 0) printf("Duration %fs\n", arguments->duration);
+    else printf("Until interrupted\n");
+    printf("Output file: %s\n", arguments->output.c_str());
+  }
+
+  fflush(stdout);
+
+  continuous.enabled = false;
+
+  if(arguments->duration <= 0) {
+    if(arguments->useBp && arguments->startAddr) {
+      printf("Sampling until interrupted is not supported with breakpoints\n");
+      fflush(stdout);
+      return;
+    }
+
+    continuous.enabled = true;
+    continuous.cores = arguments->cores;
+    continuous.timeOffset = 0;
+    continuous.lastTime = -1;
+    continuous.lastInterval = 0;
+    continuous.pending = false;
+
+    lynsyn_startPeriodSampling(CONTINUOUS_PERIOD, arguments->cores);
+
+  } else if(arguments->useBp && arguments->startAddr) {
+    if(arguments->useFrameBp) lynsyn_setMarkBreakpoint(arguments->frameAddr);
+    else lynsyn_clearMarkBreakpoint();
+
+    if(!arguments->cores || !arguments->endAddr) {
+      lynsyn_startBpPeriodSampling(arguments->startAddr, arguments->duration, arguments->cores);
+    } else {
+      lynsyn_startBpSampling(arguments->startAddr, arguments->endAddr, arguments->cores);
+    }
+  } else {
+    lynsyn_startPeriodSampling(arguments->duration, arguments->cores);
+  }
+
+  unsigned cores = 0;
+  for(int i = 0; i < 8; i++) {
+    if(arguments->cores & (1 << i)) cores++;
+  }
+
+  writeSamples(arguments, lynsyn_numSensors(), cores, arguments->cores);
+
+  if(continuous.enabled) {
+    // read out the rest of the current period so the board is idle
+    printf("Waiting for the board to finish sampling\n");
+    fflush(stdout);
+
+    struct LynsynSample sample;
+    while(lynsyn_getNextSample(&sample));
+  }
+
+  if(arguments->lowJitter) printTransferStats();
+
+  fflush(stdout);
+}
+
+static bool resolveSymbol(std::string symbol, uint64_t *addr) {
+  if(symbol.empty()) return true;
+
+  if(symbols) *addr = symbols->address(symbol);
+  if(!symbols || !*addr) {
+    printf("Unknown symbol %s\n", symbol.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+/** Loads all ELF and kallsyms files given for any of the runs, once */
+static bool loadSymbols(std::vector<struct arguments> &runs) {
+  std::vector<std::string> loaded;
+
+  for(auto &run : runs) {
+    for(auto &elfFile : run.elfFiles) {
+      if(std::find(loaded.begin(), loaded.end(), elfFile) != loaded.end()) continue;
+      if(!symbols) symbols = new SymbolTable();
+      if(!symbols->addElf(elfFile)) {
+        printf("Can't read symbols from %s\n", elfFile.c_str());
+        return false;
+      }
+      loaded.push_back(elfFile);
+    }
+    for(auto &symsFile : run.kallsyms) {
+      if(std::find(loaded.begin(), loaded.end(), symsFile) != loaded.end()) continue;
+      if(!symbols) symbols = new SymbolTable();
+      if(!symbols->addKallsyms(symsFile)) {
+        printf("Can't read symbols from %s\n", symsFile.c_str());
+        return false;
+      }
+      loaded.push_back(symsFile);
+    }
+  }
+
+  if(symbols) printf("Loaded %u symbols\n", (unsigned)symbols->size());
+
+  for(auto &run : runs) {
+    if(!resolveSymbol(run.startSymbol, &run.startAddr)) return false;
+    if(!resolveSymbol(run.endSymbol, &run.endAddr)) return false;
+    if(!resolveSymbol(run.frameSymbol, &run.frameAddr)) return false;
+  }
+
+  return true;
+}
+
+static void finishArguments(struct arguments *arguments) {
+  if(arguments->useFrameBp && arguments->frames.empty()) arguments->frames = "frames.csv";
+}
+
+/**
+ * Reads a plan file.  Each line holds the options for one capture, in the
+ * same syntax as the command line, on top of the options given on the
+ * command line.  Empty lines and lines starting with # are ignored.
+ */
+static bool readPlan(struct arguments *base, std::vector<struct arguments> &runs) {
+  std::ifstream plan(base->plan);
+  if(!plan.is_open()) {
+    printf("Can't open plan file %s\n", base->plan.c_str());
+    return false;
+  }
+
+  std::string line;
+  unsigned lineNum = 0;
+
+  while(std::getline(plan, line)) {
+    lineNum++;
+
+    std::vector<std::string> tokens;
+    std::string token;
+    bool inToken = false;
+    char quote = 0;
+
+    for(char c : line) {
+      if(quote) {
+        if(c == quote) quote = 0;
+        else token += c;
+      } else if((c == '"') || (c == '\'')) {
+        quote = c;
+        inToken = true;
+      } else if(isspace(c)) {
+        if(inToken) tokens.push_back(token);
+        token.clear();
+        inToken = false;
+      } else if((c == '#') && !inToken) {
+        break;
+      } else {
+        token += c;
+        inToken = true;
+      }
+    }
+    if(inToken) tokens.push_back(token);
+
+    if(tokens.empty()) continue;
+
+    // argp reports errors using argv[0]
+    std::string name = base->plan + ":" + std::to_string(lineNum);
+    std::vector<char*> argv;
+    argv.push_back((char*)name.c_str());
+    for(unsigned i = 0; i < tokens.size(); i++) argv.push_back((char*)tokens[i].c_str());
+    argv.push_back(NULL);
+
+    struct arguments run = *base;
+    run.plan.clear();
+
+    argp_parse(&argp, argv.size() - 1, argv.data(), 0, 0, &run);
+
+    if(!run.plan.empty()) {
+      printf("%s: Plans can not be nested\n", name.c_str());
+      return false;
+    }
+
+    finishArguments(&run);
+    runs.push_back(run);
+  }
+
+  if(runs.empty()) {
+    printf("No captures in plan file %s\n", base->plan.c_str());
+    return false;
+  }
+
+  return true;
+}
+
 int main(int argc, char *argv[]) {
   struct arguments arguments;
   arguments.cores = 0;
@@ -125,91 +711,99 @@ int main(int argc, char *argv[]) {
   arguments.frameAddr = 0;
   arguments.duration = 10;
   arguments.output = "output.csv";
+  arguments.format = "csv";
+  arguments.preTrigger = 1;
+  arguments.postTrigger = 1;
+  arguments.noRaw = false;
+  arguments.flushInterval = FLUSH_AUTO;
+  arguments.dropSamples = false;
+  arguments.rotateSize = 0;
+  arguments.rotateTime = 0;
+  arguments.keep = 0;
+  arguments.lowJitter = false;
+  arguments.lowJitterCpu = -1;
 
   argp_parse (&argp, argc, argv, 0, 0, &arguments);
 
-  if(arguments.useBp) {
-    printf("Sampling PC and power\n");
-    printf("From breakpoint %" LONGLONGHEX " to breakpoint %" LONGLONGHEX, arguments.startAddr, arguments.endAddr);
-    if(arguments.useFrameBp) printf(" using frame breakpoint %" LONGLONGHEX "\n", arguments.frameAddr);
-    else printf("\n");
-    printf("Maximum duration %fs\n", arguments.duration);
-    printf("Output file: %s\n", arguments.output.c_str());
+  std::vector<struct arguments> runs;
 
+  if(arguments.plan.empty()) {
+    finishArguments(&arguments);
+    runs.push_back(arguments);
   } else {
-    printf("Sampling power\n");
-    printf("Duration %fs\n", arguments.duration);
-    printf("Output file: %s\n", arguments.output.c_str());
+    if(!readPlan(&arguments, runs)) exit(-1);
   }
 
-  fflush(stdout);
+  bool useBoard = false;
+  bool useJtag = false;
+  bool lowJitter = false;
+  int lowJitterCpu = -1;
 
-  if(lynsyn_init()) {
-    if(arguments.useBp || arguments.cores) {
-      if(!lynsyn_jtagInit(lynsyn_getDefaultJtagDevices())) {
-        printf("Can't init JTAG chain\n");
-        fflush(stdout);
-        exit(-1);
-      }
-    }
+  for(unsigned i = 0; i < runs.size(); i++) {
+    if((runs[i].output == "-") || (runs[i].frames == "-")) OutputSink::redirectMessages();
 
-    if(arguments.useBp && arguments.startAddr) {
-      if(!arguments.cores || !arguments.endAddr) {
-        lynsyn_startBpPeriodSampling(arguments.startAddr, arguments.duration, arguments.cores);
-      } else {
-        lynsyn_startBpSampling(arguments.startAddr, arguments.endAddr, arguments.cores);
+    if(runs[i].input.empty()) {
+      useBoard = true;
+      if(runs[i].useBp || runs[i].useFrameBp || runs[i].cores) useJtag = true;
+      if(runs[i].lowJitter) {
+        lowJitter = true;
+        lowJitterCpu = runs[i].lowJitterCpu;
       }
-    } else {
-      lynsyn_startPeriodSampling(arguments.duration, arguments.cores);
     }
+  }
+
+  if(!loadSymbols(runs)) exit(-1);
 
-    unsigned cores = 0;
-    for(int i = 0; i < 8; i++) {
-      if(arguments.cores & (1 << i)) cores++;
+  // frames are delimited by marks, which the board only reports from the
+  // frame breakpoint when sampling from a start to an end breakpoint
+  for(auto &run : runs) {
+    if(run.input.empty() && !run.frames.empty() &&
+       !(run.useFrameBp && run.useBp && run.startAddr && run.endAddr && run.cores)) {
+      printf("Frame output needs a frame breakpoint (-f), start and end breakpoints (-s, -e) and cores (-c)\n");
+      exit(-1);
     }
+  }
 
-    std::ofstream file(arguments.output);
-    if(!file.fail()) {
+#ifndef _WIN32
+  signal(SIGUSR1, triggerHandler);
+#endif
+  signal(SIGINT, stopHandler);
+  signal(SIGTERM, stopHandler);
 
-      file << "Sensors;Cores\n";
-      file << lynsyn_numSensors() << ";" << cores << "\n";
+  // the board and the JTAG chain are initialised once for all captures
+  if(useBoard) {
+    if(!lynsyn_init()) {
+      printf("Can't open lynsyn\n");
+      fflush(stdout);
+      return 0;
+    }
 
-      file << "Time" << std::setprecision(9) << std::fixed;
-      for(int i = 0; i < MAX_CORES; i++) {
-        file << ";pc " << i;
-      }
-      for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
-        file << ";current " << i;
-      }
-      for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
-        file << ";voltage " << i;
-      }
-      file << "\n";
-      
-      struct LynsynSample sample;
-      while(lynsyn_getNextSample(&sample)) {
-        file << lynsyn_cyclesToSeconds(sample.time);
-        for(int i = 0; i < MAX_CORES; i++) {
-          file << ";" << sample.pc[i];
-        }
-        for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
-          file << ";" << sample.current[i];
-        }
-        for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
-          file << ";" << sample.voltage[i];
-        }
-        file << "\n";
+    if(useJtag) {
+      if(!lynsyn_jtagInit(lynsyn_getDefaultJtagDevices())) {
+        printf("Can't init JTAG chain\n");
+        fflush(stdout);
+        exit(-1);
       }
-    } else {
-      printf("Can't open output file\n");
     }
 
-    lynsyn_release();
+    if(lowJitter) {
+      lynsyn_setLowJitter(lowJitterCpu, LOW_JITTER_PRIORITY);
+    }
+  }
 
-  } else {
-    printf("Can't open lynsyn\n");
+  for(unsigned i = 0; i < runs.size(); i++) {
+    if(runs.size() > 1) {
+      printf("Capture %u of %u\n", i + 1, (unsigned)runs.size());
+    }
+
+    if(!runs[i].input.empty()) convertCapture(&runs[i]);
+    else sample(&runs[i]);
+
+    if(stopRequested) break;
   }
 
+  if(useBoard) lynsyn_release();
+
   fflush(stdout);
 
   return 0;
@@ -0,0 +1,365 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#endif
+
+#include "outputsink.h"
+
+FdStreamBuf::FdStreamBuf(int fd, bool blocking) : buf(OUTPUT_BUFFER_SIZE) {
+  this->fd = fd;
+  this->blocking = blocking;
+  error = false;
+  setp(buf.data(), buf.data() + buf.size());
+
+#ifndef _WIN32
+  if(!blocking) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+#endif
+}
+
+FdStreamBuf::~FdStreamBuf() {
+  if(!blocking) {
+#ifndef _WIN32
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+#endif
+    blocking = true;
+  }
+  writePending(true);
+  close(fd);
+}
+
+bool FdStreamBuf::writePending(bool wait) {
+  char *data = pbase();
+  size_t len = pptr() - pbase();
+  size_t done = 0;
+
+  while(!error && (done < len)) {
+    ssize_t n = write(fd, data + done, len - done);
+    if(n > 0) {
+      done += n;
+    } else if((n < 0) && (errno == EINTR)) {
+      continue;
+#ifndef _WIN32
+    } else if((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+      if(!wait) break;
+      struct pollfd pfd;
+      pfd.fd = fd;
+      pfd.events = POLLOUT;
+      poll(&pfd, 1, -1);
+#endif
+    } else {
+      // reader is gone
+      error = true;
+    }
+  }
+
+  // keep what the reader did not accept at the start of the buffer
+  size_t remaining = len - done;
+  memmove(buf.data(), data + done, remaining);
+  setp(buf.data(), buf.data() + buf.size());
+  pbump(remaining);
+
+  return !error;
+}
+
+FdStreamBuf::int_type FdStreamBuf::overflow(int_type c) {
+  if(!writePending(blocking)) return traits_type::eof();
+
+  if(pptr() == epptr()) {
+    size_t used = pptr() - pbase();
+    buf.resize(buf.size() * 2);
+    setp(buf.data(), buf.data() + buf.size());
+    pbump(used);
+  }
+
+  if(!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = c;
+    pbump(1);
+  }
+
+  return traits_type::not_eof(c);
+}
+
+int FdStreamBuf::sync() {
+  return writePending(blocking) ? 0 : -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+MmapStreamBuf::MmapStreamBuf(int fd) {
+  this->fd = fd;
+  mapped = false;
+  error = false;
+  windowStart = 0;
+  allocated = 0;
+
+#ifndef _WIN32
+  if(posix_fallocate(fd, 0, OUTPUT_PREALLOC_SIZE) == 0) {
+    allocated = OUTPUT_PREALLOC_SIZE;
+    mapped = mapWindow();
+  }
+#endif
+
+  if(!mapped) useWrite();
+}
+
+MmapStreamBuf::~MmapStreamBuf() {
+  if(mapped) {
+    off_t length = windowStart + (pptr() - pbase());
+    unmapWindow();
+    if(ftruncate(fd, length) < 0) perror("Can't truncate output file");
+  } else {
+    writeBuffer();
+  }
+  close(fd);
+}
+
+bool MmapStreamBuf::mapWindow() {
+#ifndef _WIN32
+  void *window = mmap(NULL, OUTPUT_MAP_WINDOW, PROT_WRITE, MAP_SHARED, fd, windowStart);
+  if(window == MAP_FAILED) return false;
+
+  setp((char*)window, (char*)window + OUTPUT_MAP_WINDOW);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void MmapStreamBuf::unmapWindow() {
+#ifndef _WIN32
+  munmap(pbase(), OUTPUT_MAP_WINDOW);
+#endif
+  setp(NULL, NULL);
+}
+
+void MmapStreamBuf::useWrite() {
+  // continue after the data written so far, drop the preallocated tail
+  if(allocated) {
+    if(ftruncate(fd, windowStart) < 0) error = true;
+    lseek(fd, windowStart, SEEK_SET);
+    allocated = 0;
+  }
+
+  mapped = false;
+  buf.resize(OUTPUT_BUFFER_SIZE);
+  setp(buf.data(), buf.data() + buf.size());
+}
+
+bool MmapStreamBuf::writeBuffer() {
+  char *data = pbase();
+  size_t len = pptr() - pbase();
+  size_t done = 0;
+
+  while(!error && (done < len)) {
+    ssize_t n = write(fd, data + done, len - done);
+    if(n > 0) done += n;
+    else if((n < 0) && (errno == EINTR)) continue;
+    else error = true;
+  }
+
+  windowStart += done;
+  setp(buf.data(), buf.data() + buf.size());
+
+  return !error;
+}
+
+MmapStreamBuf::int_type MmapStreamBuf::overflow(int_type c) {
+  if(error) return traits_type::eof();
+
+  if(mapped) {
+    unmapWindow();
+    windowStart += OUTPUT_MAP_WINDOW;
+
+    bool ok = true;
+    if(windowStart + OUTPUT_MAP_WINDOW > allocated) {
+#ifndef _WIN32
+      ok = posix_fallocate(fd, allocated, OUTPUT_PREALLOC_SIZE) == 0;
+#endif
+      if(ok) allocated += OUTPUT_PREALLOC_SIZE;
+    }
+    if(ok) ok = mapWindow();
+
+    if(!ok) useWrite();
+
+  } else {
+    if(!writeBuffer()) return traits_type::eof();
+  }
+
+  if(error) return traits_type::eof();
+
+  if(!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = c;
+    pbump(1);
+  }
+
+  return traits_type::not_eof(c);
+}
+
+int MmapStreamBuf::sync() {
+  // mapped pages are already in the page cache
+  if(mapped) return error ? -1 : 0;
+  return writeBuffer() ? 0 : -1;
+}
+
+MmapStreamBuf::pos_type MmapStreamBuf::seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+  // only used by tellp()
+  if((off != 0) || (dir != std::ios_base::cur) || !(which & std::ios_base::out)) return pos_type(off_type(-1));
+  return pos_type(windowStart + (pptr() - pbase()));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+int OutputSink::stdoutFd = -1;
+bool OutputSink::stdoutTaken = false;
+
+void OutputSink::redirectMessages() {
+  if(stdoutFd == -1) {
+    fflush(stdout);
+    stdoutFd = dup(1);
+    dup2(2, 1);
+  }
+}
+
+OutputSink::~OutputSink() {
+  if(fdBuf || mapBuf) {
+    delete stream;
+    delete fdBuf;
+    delete mapBuf;
+  }
+
+  // the sink closed its own duplicate, so stdout can be used again
+  if(ownsStdout) stdoutTaken = false;
+}
+
+bool OutputSink::open(std::string name, bool binary, bool blocking) {
+  int fd = -1;
+
+  if(name == "-") {
+    redirectMessages();
+    if(stdoutTaken || (stdoutFd < 0)) return false;
+
+    fd = dup(stdoutFd);
+    if(fd < 0) return false;
+
+    stdoutTaken = true;
+    ownsStdout = true;
+
+#ifndef _WIN32
+  } else if(name.compare(0, 5, "unix:") == 0) {
+    std::string path = name.substr(5);
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(path.size() >= sizeof(addr.sun_path)) return false;
+    strcpy(addr.sun_path, path.c_str());
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0) return false;
+    if(connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+      close(fd);
+      return false;
+    }
+
+  } else {
+    struct stat st;
+    if((stat(name.c_str(), &st) == 0) && S_ISFIFO(st.st_mode)) {
+      fd = ::open(name.c_str(), O_WRONLY);
+      if(fd < 0) return false;
+
+    } else if(binary) {
+      int mapFd = ::open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+      if(mapFd < 0) return false;
+
+      mapBuf = new MmapStreamBuf(mapFd);
+      stream = new std::ostream(mapBuf);
+      return true;
+    }
+#endif
+  }
+
+  if(fd >= 0) {
+#ifndef _WIN32
+    // a reader that goes away ends the capture instead of killing the process
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    fdBuf = new FdStreamBuf(fd, blocking);
+    stream = new std::ostream(fdBuf);
+
+  } else {
+    mode = std::ios::out;
+    if(binary) mode |= std::ios::binary;
+
+    file.open(name, mode);
+    if(file.fail()) return false;
+
+    stream = &file;
+  }
+
+  return true;
+}
+
+bool OutputSink::reopen(std::string name) {
+  if(fdBuf) return false;
+
+#ifndef _WIN32
+  if(mapBuf) {
+    stream->rdbuf(NULL);
+    delete mapBuf;
+    mapBuf = NULL;
+
+    int fd = ::open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if(fd < 0) {
+      stream->setstate(std::ios::badbit);
+      return false;
+    }
+
+    mapBuf = new MmapStreamBuf(fd);
+    stream->rdbuf(mapBuf);
+    return true;
+  }
+#endif
+
+  file.close();
+  file.clear();
+  file.open(name, mode);
+
+  // a failed open only sets failbit, make it end the capture like a write error
+  if(file.fail()) {
+    file.setstate(std::ios::badbit);
+    return false;
+  }
+
+  return true;
+}
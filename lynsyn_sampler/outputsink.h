@@ -0,0 +1,133 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef OUTPUTSINK_H
+#define OUTPUTSINK_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <streambuf>
+
+#define OUTPUT_BUFFER_SIZE 65536
+#define OUTPUT_MAX_BACKLOG (4 * 1024 * 1024)
+
+#define OUTPUT_MAP_WINDOW (4 * 1024 * 1024)
+#define OUTPUT_PREALLOC_SIZE (32 * 1024 * 1024)
+
+/**
+ * Buffered stream on a file descriptor.  In blocking mode, writes wait until
+ * the reader has consumed the data.  In non-blocking mode, data the reader
+ * is not ready for is kept in a growing buffer, see backlog().
+ */
+class FdStreamBuf : public std::streambuf {
+  int fd;
+  bool blocking;
+  bool error;
+  std::vector<char> buf;
+
+  bool writePending(bool wait);
+
+protected:
+  int_type overflow(int_type c);
+  int sync();
+
+public:
+  FdStreamBuf(int fd, bool blocking);
+  ~FdStreamBuf();
+
+  size_t backlog() { return pptr() - pbase(); }
+};
+
+/**
+ * Binary file output through a sliding memory mapped window.  The file is
+ * preallocated in large chunks, and samples are encoded directly into the
+ * mapped pages, so there is no write() call or extra copy per buffer.  The
+ * file is truncated to the real length when closed.  If the file can't be
+ * preallocated or mapped, buffered write() calls are used instead.
+ */
+class MmapStreamBuf : public std::streambuf {
+  int fd;
+  bool mapped;
+  bool error;
+  off_t windowStart;
+  off_t allocated;
+  std::vector<char> buf;
+
+  bool mapWindow();
+  void unmapWindow();
+  void useWrite();
+  bool writeBuffer();
+
+protected:
+  int_type overflow(int_type c);
+  int sync();
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which);
+
+public:
+  MmapStreamBuf(int fd);
+  ~MmapStreamBuf();
+
+  bool isMapped() { return mapped; }
+};
+
+/**
+ * Where the samples go.  A regular file, stdout ("-"), a named pipe or a
+ * connected Unix socket ("unix:<path>").
+ */
+class OutputSink {
+  static int stdoutFd;
+  static bool stdoutTaken;
+
+  std::ofstream file;
+  std::ios_base::openmode mode;
+  FdStreamBuf *fdBuf;
+  MmapStreamBuf *mapBuf;
+  std::ostream *stream;
+  bool ownsStdout;
+
+public:
+  OutputSink() {
+    fdBuf = NULL;
+    mapBuf = NULL;
+    stream = NULL;
+    ownsStdout = false;
+  }
+  ~OutputSink();
+
+  /** Sends stdout messages to stderr, keeping stdout free for samples.  One sink at a time owns stdout, until it is destroyed */
+  static void redirectMessages();
+
+  /** Binary files are written through MmapStreamBuf, everything else through ofstream or FdStreamBuf */
+  bool open(std::string name, bool binary, bool blocking);
+
+  /** Closes the current file and continues in a new one, keeping the same stream.  On failure the stream is left bad, see failed() */
+  bool reopen(std::string name);
+
+  std::ostream &out() { return *stream; }
+  bool isStream() { return fdBuf != NULL; }
+  bool failed() { return !stream || stream->bad(); }
+
+  /** @return Number of bytes written but not yet accepted by the reader */
+  size_t backlog() { return fdBuf ? fdBuf->backlog() : 0; }
+};
+
+#endif
@@ -0,0 +1,110 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+
+#include "rotatingwriter.h"
+
+std::string RotatingWriter::fileName(std::string baseName, unsigned fileNum) {
+  char num[16];
+  snprintf(num, sizeof(num), ".%06u", fileNum);
+
+  size_t dot = baseName.rfind('.');
+  size_t slash = baseName.find_last_of("/\\");
+  if((dot == std::string::npos) || ((slash != std::string::npos) && (dot < slash))) {
+    return baseName + num;
+  }
+  return baseName.substr(0, dot) + num + baseName.substr(dot);
+}
+
+RotatingWriter::RotatingWriter(SampleWriter *writer, OutputSink *sink, std::string baseName, uint64_t maxSize, double maxSeconds, unsigned keep) : SampleWriter(writer->stream()) {
+  this->writer = writer;
+  this->sink = sink;
+  this->baseName = baseName;
+  this->maxSize = maxSize;
+  this->maxCycles = lynsyn_secondsToCycles(maxSeconds);
+  this->keep = keep;
+  failed = false;
+}
+
+void RotatingWriter::rotate() {
+  writer->finish();
+
+  fileNum++;
+  std::string name = fileName(baseName, fileNum);
+  if(!sink->reopen(name)) {
+    // the sink is now failed, which ends the capture
+    printf("Can't open output file %s\n", name.c_str());
+    fflush(stdout);
+    failed = true;
+    return;
+  }
+  files.push_back(name);
+
+  while(keep && (files.size() > keep)) {
+    remove(files.front().c_str());
+    files.pop_front();
+  }
+
+  writer->writeHeader(sensors, cores, coreMask);
+  fileStart = -1;
+  sinceSizeCheck = 0;
+}
+
+void RotatingWriter::writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask) {
+  SampleWriter::writeHeader(sensors, cores, coreMask);
+
+  fileNum = 0;
+  fileStart = -1;
+  sinceSizeCheck = 0;
+  failed = false;
+  files.clear();
+  files.push_back(fileName(baseName, 0));
+
+  writer->writeHeader(sensors, cores, coreMask);
+}
+
+void RotatingWriter::writeSample(struct LynsynSample *sample) {
+  if(failed) return;
+
+  if(fileStart != -1) {
+    bool full = false;
+    if(maxSize && (++sinceSizeCheck >= ROTATE_SIZE_INTERVAL)) {
+      sinceSizeCheck = 0;
+      full = (uint64_t)out.tellp() >= maxSize;
+    }
+
+    if(full || (maxCycles && (sample->time - fileStart >= maxCycles))) {
+      rotate();
+      if(failed) return;
+    }
+  }
+
+  if(fileStart == -1) fileStart = sample->time;
+
+  writer->writeSample(sample);
+}
+
+void RotatingWriter::finish() {
+  // the wrapped writer was already finished before the failed rotation
+  if(failed) return;
+  writer->finish();
+}
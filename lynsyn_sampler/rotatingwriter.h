@@ -0,0 +1,72 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef ROTATINGWRITER_H
+#define ROTATINGWRITER_H
+
+#include <string>
+#include <deque>
+
+#include "samplewriter.h"
+#include "outputsink.h"
+
+// tellp() is a system call on an ofstream, so the file size is only
+// checked this often (in samples)
+#define ROTATE_SIZE_INTERVAL 1024
+
+/**
+ * Splits the output of the wrapped writer into numbered files when a file
+ * reaches a size or covers a time span.  Every file starts with a complete
+ * header, and sample times are absolute, so consecutive files can be
+ * concatenated without loss.  Only the newest files are kept if a retention
+ * limit is given.
+ */
+class RotatingWriter : public SampleWriter {
+  SampleWriter *writer;
+  OutputSink *sink;
+  std::string baseName;
+  uint64_t maxSize;
+  int64_t maxCycles;
+  unsigned keep;
+
+  unsigned fileNum;
+  int64_t fileStart;
+  unsigned sinceSizeCheck;
+  bool failed;
+  std::deque<std::string> files;
+
+  void rotate();
+
+public:
+  /** @return Name of the given file number, the number is inserted before the extension */
+  static std::string fileName(std::string baseName, unsigned fileNum);
+
+  RotatingWriter(SampleWriter *writer, OutputSink *sink, std::string baseName, uint64_t maxSize, double maxSeconds, unsigned keep);
+  ~RotatingWriter() {
+    delete writer;
+  }
+
+  void writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask);
+  void writeSample(struct LynsynSample *sample);
+  void finish();
+};
+
+#endif
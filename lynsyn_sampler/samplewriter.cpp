@@ -0,0 +1,107 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <iomanip>
+
+#include "samplewriter.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CsvWriter::writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask) {
+  SampleWriter::writeHeader(sensors, cores, coreMask);
+
+  out << "Sensors;Cores\n";
+  out << sensors << ";" << cores << "\n";
+
+  out << "Time" << std::setprecision(9) << std::fixed;
+  for(int i = 0; i < MAX_CORES; i++) {
+    out << ";pc " << i;
+  }
+  for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
+    out << ";current " << i;
+  }
+  for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
+    out << ";voltage " << i;
+  }
+  out << "\n";
+}
+
+void CsvWriter::writeSample(struct LynsynSample *sample) {
+  if(sample->flags & SAMPLE_FLAG_GAP) return;
+
+  out << lynsyn_cyclesToSeconds(sample->time);
+  for(int i = 0; i < MAX_CORES; i++) {
+    out << ";" << sample->pc[i];
+  }
+  for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
+    out << ";" << sample->current[i];
+  }
+  for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
+    out << ";" << sample->voltage[i];
+  }
+  out << "\n";
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void CompressedWriter::writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask) {
+  SampleWriter::writeHeader(sensors, cores, coreMask);
+
+  struct CaptureHeader header;
+  header.magic = CAPTURE_MAGIC;
+  header.version = CAPTURE_VERSION;
+  header.reserved = 0;
+  header.sensors = sensors;
+  header.cores = cores;
+  header.coreMask = coreMask;
+
+  uint8_t buf[CAPTURE_HEADER_SIZE];
+  encodeCaptureHeader(&header, buf);
+  out.write((char*)buf, sizeof(buf));
+
+  delete encoder;
+  encoder = new SampleEncoder(sensors);
+}
+
+void CompressedWriter::writeBlock() {
+  const std::vector<uint8_t> &buf = encoder->flush();
+
+  struct CaptureBlockHeader blockHeader;
+  blockHeader.samples = encoder->numSamples();
+  blockHeader.bytes = buf.size();
+
+  uint8_t headerBuf[CAPTURE_BLOCK_HEADER_SIZE];
+  encodeCaptureBlockHeader(&blockHeader, headerBuf);
+  out.write((char*)headerBuf, sizeof(headerBuf));
+  out.write((char*)buf.data(), buf.size());
+
+  encoder->reset();
+}
+
+void CompressedWriter::writeSample(struct LynsynSample *sample) {
+  encoder->add(sample);
+  if(encoder->numSamples() >= CAPTURE_BLOCK_SAMPLES) writeBlock();
+}
+
+void CompressedWriter::finish() {
+  if(encoder && encoder->numSamples()) writeBlock();
+  out.flush();
+}
@@ -0,0 +1,81 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef SAMPLEWRITER_H
+#define SAMPLEWRITER_H
+
+#include <ostream>
+
+#include <lynsyn.h>
+
+#include "compress.h"
+
+class SampleWriter {
+protected:
+  std::ostream &out;
+  unsigned sensors;
+  unsigned cores;
+  uint64_t coreMask;
+
+public:
+  SampleWriter(std::ostream &out) : out(out) {}
+  virtual ~SampleWriter() {}
+
+  std::ostream &stream() { return out; }
+
+  virtual void writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask) {
+    this->sensors = sensors;
+    this->cores = cores;
+    this->coreMask = coreMask;
+  }
+  virtual void writeSample(struct LynsynSample *sample) = 0;
+  virtual void finish() {}
+};
+
+/** Text output, one line per sample, semicolon separated */
+class CsvWriter : public SampleWriter {
+public:
+  CsvWriter(std::ostream &out) : SampleWriter(out) {}
+
+  void writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask);
+  void writeSample(struct LynsynSample *sample);
+};
+
+/** Compressed binary output, see compress.h for the format */
+class CompressedWriter : public SampleWriter {
+  SampleEncoder *encoder;
+
+  void writeBlock();
+
+public:
+  CompressedWriter(std::ostream &out) : SampleWriter(out) {
+    encoder = NULL;
+  }
+  ~CompressedWriter() {
+    delete encoder;
+  }
+
+  void writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask);
+  void writeSample(struct LynsynSample *sample);
+  void finish();
+};
+
+#endif
@@ -0,0 +1,181 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <iomanip>
+
+#include "summarywriter.h"
+
+// values closer to zero than this are counted as zero
+#define SKETCH_MIN_VALUE 1e-12
+
+static const double quantiles[] = { 0.5, 0.95, 0.99 };
+static const char *quantileNames[] = { "p50", "p95", "p99" };
+#define NUM_QUANTILES (sizeof(quantiles) / sizeof(quantiles[0]))
+
+///////////////////////////////////////////////////////////////////////////////
+
+QuantileSketch::QuantileSketch(double accuracy) {
+  gamma = (1 + accuracy) / (1 - accuracy);
+  logGamma = log(gamma);
+  zeroCount = 0;
+  count = 0;
+}
+
+int QuantileSketch::index(double val) {
+  return (int)ceil(log(val) / logGamma);
+}
+
+double QuantileSketch::value(int index) {
+  return 2 * pow(gamma, index) / (gamma + 1);
+}
+
+void QuantileSketch::add(double val) {
+  if(val > SKETCH_MIN_VALUE) positive[index(val)]++;
+  else if(val < -SKETCH_MIN_VALUE) negative[index(-val)]++;
+  else zeroCount++;
+  count++;
+}
+
+void QuantileSketch::merge(const QuantileSketch &other) {
+  for(auto bucket : other.positive) positive[bucket.first] += bucket.second;
+  for(auto bucket : other.negative) negative[bucket.first] += bucket.second;
+  zeroCount += other.zeroCount;
+  count += other.count;
+}
+
+double QuantileSketch::quantile(double q) {
+  if(!count) return 0;
+
+  double rank = q * (count - 1);
+  uint64_t acc = 0;
+
+  for(auto it = negative.rbegin(); it != negative.rend(); it++) {
+    acc += it->second;
+    if(acc > rank) return -value(it->first);
+  }
+
+  acc += zeroCount;
+  if(acc > rank) return 0;
+
+  for(auto bucket : positive) {
+    acc += bucket.second;
+    if(acc > rank) return value(bucket.first);
+  }
+
+  return value(positive.rbegin()->first);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SensorSummary::add(double power, double seconds) {
+  if(!sketch.size() || (power < minPower)) minPower = power;
+  if(!sketch.size() || (power > maxPower)) maxPower = power;
+  energy += power * seconds;
+  sketch.add(power);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SummaryWriter::writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask) {
+  SampleWriter::writeHeader(sensors, cores, coreMask);
+
+  samples = 0;
+  cycles = 0;
+  lastTime = -1;
+  for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
+    summary[i] = SensorSummary();
+  }
+}
+
+void SummaryWriter::writeSample(struct LynsynSample *sample) {
+  if(sample->flags & (SAMPLE_FLAG_MARK | SAMPLE_FLAG_GAP)) {
+    // halted at a mark or not sampled, pc[0] is when sampling resumed
+    lastTime = sample->pc[0];
+    return;
+  }
+
+  int64_t timeSinceLast = 0;
+  if(lastTime != -1) timeSinceLast = sample->time - lastTime;
+  lastTime = sample->time;
+  cycles += timeSinceLast;
+
+  double seconds = lynsyn_cyclesToSeconds(timeSinceLast);
+
+  for(unsigned sensor = 0; sensor < sensors; sensor++) {
+    summary[sensor].add(sample->current[sensor] * sample->voltage[sensor], seconds);
+  }
+
+  samples++;
+}
+
+void SummaryWriter::finish() {
+  // time halted at marks is not included
+  double duration = lynsyn_cyclesToSeconds(cycles);
+
+  out << std::setprecision(9) << std::fixed;
+  out << "{\n";
+  out << "  \"samples\": " << samples << ",\n";
+  out << "  \"duration\": " << duration << ",\n";
+  out << "  \"sensors\": [";
+
+  printf("Samples: %" PRIu64 "\n", samples);
+  printf("Duration: %fs\n", duration);
+  printf("%-8s %12s %12s %12s %12s", "Sensor", "Energy [J]", "Mean [W]", "Min [W]", "Max [W]");
+  for(unsigned q = 0; q < NUM_QUANTILES; q++) {
+    printf(" %8s [W]", quantileNames[q]);
+  }
+  printf("\n");
+
+  for(unsigned sensor = 0; sensor < sensors; sensor++) {
+    SensorSummary *s = &summary[sensor];
+    double mean = (duration > 0) ? s->energy / duration : s->minPower;
+
+    out << (sensor ? "," : "") << "\n    {\n";
+    out << "      \"sensor\": " << sensor + 1 << ",\n";
+    out << "      \"energy\": " << s->energy << ",\n";
+    out << "      \"mean\": " << mean << ",\n";
+    out << "      \"min\": " << s->minPower << ",\n";
+    out << "      \"max\": " << s->maxPower;
+
+    printf("%-8u %12.6f %12.6f %12.6f %12.6f", sensor + 1, s->energy, mean, s->minPower, s->maxPower);
+
+    for(unsigned q = 0; q < NUM_QUANTILES; q++) {
+      // the sketch is only accurate to a relative error, keep within observed range
+      double val = s->sketch.quantile(quantiles[q]);
+      if(val < s->minPower) val = s->minPower;
+      if(val > s->maxPower) val = s->maxPower;
+
+      out << ",\n      \"" << quantileNames[q] << "\": " << val;
+      printf(" %12.6f", val);
+    }
+
+    out << "\n    }";
+    printf("\n");
+  }
+
+  out << "\n  ]\n}\n";
+  out.flush();
+
+  fflush(stdout);
+}
@@ -0,0 +1,91 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef SUMMARYWRITER_H
+#define SUMMARYWRITER_H
+
+#include <map>
+
+#include "samplewriter.h"
+
+#define SKETCH_ACCURACY 0.01
+
+/**
+ * Streaming quantile sketch with bounded relative error (DDSketch).
+ * Values are counted in logarithmically sized buckets, so memory is
+ * proportional to the dynamic range of the data and not to the number of
+ * samples.  Two sketches with the same accuracy can be merged.
+ */
+class QuantileSketch {
+  double gamma;
+  double logGamma;
+  std::map<int, uint64_t> positive;
+  std::map<int, uint64_t> negative;
+  uint64_t zeroCount;
+  uint64_t count;
+
+  int index(double val);
+  double value(int index);
+
+public:
+  QuantileSketch(double accuracy = SKETCH_ACCURACY);
+
+  void add(double val);
+  void merge(const QuantileSketch &other);
+  double quantile(double q);
+  uint64_t size() { return count; }
+};
+
+class SensorSummary {
+public:
+  QuantileSketch sketch;
+  double energy;
+  double minPower;
+  double maxPower;
+
+  SensorSummary() {
+    energy = 0;
+    minPower = 0;
+    maxPower = 0;
+  }
+
+  void add(double power, double seconds);
+};
+
+/**
+ * Writes no per sample output, only aggregated per sensor statistics when
+ * sampling has finished: JSON to the output stream and a text table to stdout.
+ */
+class SummaryWriter : public SampleWriter {
+  SensorSummary summary[LYNSYN_MAX_SENSORS];
+  uint64_t samples;
+  int64_t cycles;
+  int64_t lastTime;
+
+public:
+  SummaryWriter(std::ostream &out) : SampleWriter(out) {}
+
+  void writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask);
+  void writeSample(struct LynsynSample *sample);
+  void finish();
+};
+
+#endif
@@ -0,0 +1,192 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <algorithm>
+#include <fstream>
+
+#include "symboltable.h"
+
+static bool isFunction(char type) {
+  return (type == 't') || (type == 'T') || (type == 'w') || (type == 'W');
+}
+
+static bool lowerAddress(const struct Symbol &a, const struct Symbol &b) {
+  return a.address < b.address;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+SymbolTable::SymbolTable() {
+  sorted = true;
+  names.push_back("Unknown");
+  modules.push_back("Unknown");
+}
+
+unsigned SymbolTable::nameId(const std::string &name) {
+  std::map<std::string, unsigned>::iterator it = nameIds.find(name);
+  if(it != nameIds.end()) return it->second;
+
+  unsigned id = names.size();
+  names.push_back(name);
+  nameIds[name] = id;
+  return id;
+}
+
+unsigned SymbolTable::moduleId(const std::string &module) {
+  std::map<std::string, unsigned>::iterator it = moduleIds.find(module);
+  if(it != moduleIds.end()) return it->second;
+
+  unsigned id = modules.size();
+  modules.push_back(module);
+  moduleIds[module] = id;
+  return id;
+}
+
+void SymbolTable::add(uint64_t address, uint64_t size, const std::string &name, const std::string &module) {
+  struct Symbol symbol;
+  symbol.address = address;
+  symbol.end = size ? address + size : 0;
+  symbol.name = nameId(name);
+  symbol.module = moduleId(module);
+  symbols.push_back(symbol);
+  sorted = false;
+}
+
+void SymbolTable::sort() {
+  std::stable_sort(symbols.begin(), symbols.end(), lowerAddress);
+
+  // symbols without a size extend to the next symbol at a higher address
+  uint64_t next = 0;
+  for(int i = symbols.size() - 1; i >= 0; i--) {
+    if((i + 1 < (int)symbols.size()) && (symbols[i + 1].address > symbols[i].address)) next = symbols[i + 1].address;
+    if(!symbols[i].end) symbols[i].end = (next > symbols[i].address) ? next : symbols[i].address + 1;
+  }
+
+  cache.clear();
+  sorted = true;
+}
+
+bool SymbolTable::addElf(std::string elfFile) {
+  const char *crossCompile = getenv("CROSS_COMPILE");
+  std::string cmd = std::string(crossCompile ? crossCompile : "") + "nm -C -S --defined-only \"" + elfFile + "\"";
+
+  FILE *fp = popen(cmd.c_str(), "r");
+  if(!fp) return false;
+
+  std::string module = elfFile.substr(elfFile.find_last_of("/\\") + 1);
+  unsigned found = 0;
+  char line[4096];
+
+  // lines are "address [size] type name", the name may contain spaces
+  while(fgets(line, sizeof(line), fp)) {
+    line[strcspn(line, "\r\n")] = 0;
+
+    char *p = line;
+    char *end;
+    uint64_t address = strtoull(p, &end, 16);
+    if((end == p) || (*end != ' ')) continue;
+    p = end + 1;
+
+    uint64_t size = 0;
+    if(p[0] && (p[1] != ' ')) {
+      size = strtoull(p, &end, 16);
+      if((end == p) || (*end != ' ')) continue;
+      p = end + 1;
+    }
+
+    char type = p[0];
+    if(!type || (p[1] != ' ') || !isFunction(type)) continue;
+
+    add(address, size, p + 2, module);
+    found++;
+  }
+
+  pclose(fp);
+
+  return found > 0;
+}
+
+bool SymbolTable::addKallsyms(std::string symsFile) {
+  std::ifstream file(symsFile);
+  if(!file.is_open()) return false;
+
+  unsigned found = 0;
+  bool allZero = true;
+  std::string line;
+
+  // lines are "address type name [module]"
+  while(std::getline(file, line)) {
+    char name[1024];
+    char module[256];
+    char type;
+    uint64_t address;
+
+    int n = sscanf(line.c_str(), "%" SCNx64 " %c %1023s [%255[^]]]", &address, &type, name, module);
+    if((n < 3) || !isFunction(type)) continue;
+
+    if(address) allZero = false;
+    add(address, 0, name, (n == 4) ? module : "kernel");
+    found++;
+  }
+
+  if(found && allZero) {
+    printf("All kallsyms addresses are zero, read %s as root\n", symsFile.c_str());
+    fflush(stdout);
+  }
+
+  return found > 0;
+}
+
+const struct Symbol *SymbolTable::lookup(uint64_t pc) {
+  if(!sorted) sort();
+
+  std::unordered_map<uint64_t, int>::iterator it = cache.find(pc);
+  if(it != cache.end()) return (it->second >= 0) ? &symbols[it->second] : NULL;
+
+  struct Symbol key;
+  key.address = pc;
+  std::vector<struct Symbol>::iterator sym = std::upper_bound(symbols.begin(), symbols.end(), key, lowerAddress);
+
+  int index = -1;
+  if(sym != symbols.begin()) {
+    sym--;
+    if(pc < sym->end) index = sym - symbols.begin();
+  }
+
+  cache[pc] = index;
+
+  return (index >= 0) ? &symbols[index] : NULL;
+}
+
+uint64_t SymbolTable::address(std::string name) {
+  std::map<std::string, unsigned>::iterator it = nameIds.find(name);
+  if(it == nameIds.end()) return 0;
+
+  for(auto &symbol : symbols) {
+    if(symbol.name == it->second) return symbol.address;
+  }
+
+  return 0;
+}
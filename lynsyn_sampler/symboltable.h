@@ -0,0 +1,85 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef SYMBOLTABLE_H
+#define SYMBOLTABLE_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+#define SYMBOL_UNKNOWN 0
+
+struct Symbol {
+  uint64_t address;
+  uint64_t end;
+  unsigned name;
+  unsigned module;
+};
+
+/**
+ * Sorted in-memory index of the function symbols of ELF files (read with
+ * nm) and kallsyms files.  Every distinct PC is looked up once and cached.
+ * Function and module names are numbered, so writers can emit small IDs and
+ * the name dictionaries separately.  ID SYMBOL_UNKNOWN is "Unknown".
+ */
+class SymbolTable {
+  std::vector<struct Symbol> symbols;
+  std::vector<std::string> names;
+  std::vector<std::string> modules;
+  std::map<std::string, unsigned> nameIds;
+  std::map<std::string, unsigned> moduleIds;
+  std::unordered_map<uint64_t, int> cache;
+  bool sorted;
+
+  unsigned nameId(const std::string &name);
+  unsigned moduleId(const std::string &module);
+  void add(uint64_t address, uint64_t size, const std::string &name, const std::string &module);
+  void sort();
+
+public:
+  SymbolTable();
+
+  bool addElf(std::string elfFile);
+  bool addKallsyms(std::string symsFile);
+
+  /** @return The symbol containing the given PC, or NULL */
+  const struct Symbol *lookup(uint64_t pc);
+
+  unsigned function(uint64_t pc) {
+    const struct Symbol *symbol = lookup(pc);
+    return symbol ? symbol->name : SYMBOL_UNKNOWN;
+  }
+  unsigned module(uint64_t pc) {
+    const struct Symbol *symbol = lookup(pc);
+    return symbol ? symbol->module : SYMBOL_UNKNOWN;
+  }
+
+  /** @return Address of the given function, or 0 if not found */
+  uint64_t address(std::string name);
+
+  const std::vector<std::string> &functionNames() { return names; }
+  const std::vector<std::string> &moduleNames() { return modules; }
+  size_t size() { return symbols.size(); }
+};
+
+#endif
@@ -0,0 +1,232 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <string.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include "tracewriter.h"
+
+// Perfetto protobuf field numbers (perfetto/protos/perfetto/trace/)
+
+#define TRACE_PACKET                   1
+
+#define PACKET_TIMESTAMP               8
+#define PACKET_SEQUENCE_ID            10
+#define PACKET_TRACK_EVENT            11
+#define PACKET_INTERNED_DATA          12
+#define PACKET_SEQUENCE_FLAGS         13
+#define PACKET_TRACK_DESCRIPTOR       60
+
+#define SEQ_INCREMENTAL_STATE_CLEARED  1
+#define SEQ_NEEDS_INCREMENTAL_STATE    2
+
+#define TRACK_UUID                     1
+#define TRACK_NAME                     2
+#define TRACK_COUNTER                  8
+
+#define EVENT_TYPE                     9
+#define EVENT_NAME_IID                10
+#define EVENT_TRACK_UUID              11
+#define EVENT_DOUBLE_COUNTER_VALUE    44
+
+#define TYPE_SLICE_BEGIN               1
+#define TYPE_SLICE_END                 2
+#define TYPE_INSTANT                   3
+#define TYPE_COUNTER                   4
+
+#define INTERNED_EVENT_NAMES           2
+#define EVENT_NAME_IID_FIELD           1
+#define EVENT_NAME_NAME                2
+
+#define SEQUENCE_ID                    1
+
+#define SENSOR_TRACK_UUID(x) (1000 + (x))
+#define CORE_TRACK_UUID(x)   (2000 + (x))
+#define MARK_TRACK_UUID      3000
+
+///////////////////////////////////////////////////////////////////////////////
+
+void ProtoBuffer::addVarint(uint64_t val) {
+  while(val >= 0x80) {
+    buf += (char)((val & 0x7f) | 0x80);
+    val >>= 7;
+  }
+  buf += (char)val;
+}
+
+void ProtoBuffer::addDouble(unsigned field, double val) {
+  char bytes[8];
+  memcpy(bytes, &val, 8);
+  addTag(field, 1);
+  buf.append(bytes, 8);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+uint64_t TraceWriter::toNs(int64_t time) {
+  uint64_t t = time;
+  return (t / LYNSYN_FREQ) * 1000000000ull + ((t % LYNSYN_FREQ) * 1000000000ull) / LYNSYN_FREQ;
+}
+
+void TraceWriter::writePacket() {
+  scratch.clear();
+  scratch.addMessage(TRACE_PACKET, packet);
+  out.write(scratch.buf.data(), scratch.buf.size());
+  packet.clear();
+}
+
+void TraceWriter::writeTrackDescriptor(uint64_t uuid, std::string name, bool counter) {
+  ProtoBuffer track;
+  track.addUint(TRACK_UUID, uuid);
+  track.addBytes(TRACK_NAME, name);
+  if(counter) track.addMessage(TRACK_COUNTER, ProtoBuffer());
+
+  packet.addUint(PACKET_SEQUENCE_ID, SEQUENCE_ID);
+  if(firstPacket) {
+    packet.addUint(PACKET_SEQUENCE_FLAGS, SEQ_INCREMENTAL_STATE_CLEARED);
+    firstPacket = false;
+  }
+  packet.addMessage(PACKET_TRACK_DESCRIPTOR, track);
+  writePacket();
+}
+
+void TraceWriter::writeEvent(uint64_t timestamp, uint64_t trackUuid, unsigned type, const std::string *name, double *value) {
+  event.clear();
+  event.addUint(EVENT_TYPE, type);
+  event.addUint(EVENT_TRACK_UUID, trackUuid);
+
+  packet.addUint(PACKET_TIMESTAMP, timestamp);
+  packet.addUint(PACKET_SEQUENCE_ID, SEQUENCE_ID);
+
+  if(name) {
+    uint64_t iid;
+    std::map<std::string, uint64_t>::iterator it = internedNames.find(*name);
+    if(it != internedNames.end()) {
+      iid = it->second;
+    } else {
+      iid = internedNames.size() + 1;
+      internedNames[*name] = iid;
+
+      ProtoBuffer eventName;
+      eventName.addUint(EVENT_NAME_IID_FIELD, iid);
+      eventName.addBytes(EVENT_NAME_NAME, *name);
+      ProtoBuffer internedData;
+      internedData.addMessage(INTERNED_EVENT_NAMES, eventName);
+      packet.addMessage(PACKET_INTERNED_DATA, internedData);
+    }
+    event.addUint(EVENT_NAME_IID, iid);
+    packet.addUint(PACKET_SEQUENCE_FLAGS, SEQ_NEEDS_INCREMENTAL_STATE);
+  }
+
+  if(value) event.addDouble(EVENT_DOUBLE_COUNTER_VALUE, *value);
+
+  packet.addMessage(PACKET_TRACK_EVENT, event);
+  writePacket();
+}
+
+std::string TraceWriter::pcName(uint64_t pc) {
+  if(symbols) {
+    unsigned function = symbols->function(pc);
+    if(function != SYMBOL_UNKNOWN) return symbols->functionNames()[function];
+  }
+
+  char buf[32];
+  snprintf(buf, sizeof(buf), "0x%" PRIx64, pc);
+  return buf;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+void TraceWriter::writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask) {
+  SampleWriter::writeHeader(sensors, cores, coreMask);
+
+  firstPacket = true;
+  lastTimestamp = 0;
+  internedNames.clear();
+
+  for(unsigned sensor = 0; sensor < sensors; sensor++) {
+    writeTrackDescriptor(SENSOR_TRACK_UUID(sensor), "Sensor " + std::to_string(sensor + 1) + " power [W]", true);
+    lastPower[sensor] = -1;
+  }
+
+  for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
+    sliceOpen[core] = false;
+    if(coreMask & (1 << core)) {
+      writeTrackDescriptor(CORE_TRACK_UUID(core), "Core " + std::to_string(core), false);
+    }
+  }
+
+  writeTrackDescriptor(MARK_TRACK_UUID, "Marks", false);
+}
+
+void TraceWriter::writeSample(struct LynsynSample *sample) {
+  uint64_t timestamp = toNs(sample->time);
+
+  if(sample->flags & SAMPLE_FLAG_GAP) {
+    // nothing is known about the PCs until sampling resumes
+    for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
+      if(sliceOpen[core]) {
+        writeEvent(timestamp, CORE_TRACK_UUID(core), TYPE_SLICE_END, NULL, NULL);
+        sliceOpen[core] = false;
+      }
+    }
+    return;
+  }
+
+  if(sample->flags & SAMPLE_FLAG_MARK) {
+    static const std::string markName = "Mark";
+    writeEvent(timestamp, MARK_TRACK_UUID, TYPE_INSTANT, &markName, NULL);
+    return;
+  }
+
+  lastTimestamp = timestamp;
+
+  for(unsigned sensor = 0; sensor < sensors; sensor++) {
+    double power = sample->current[sensor] * sample->voltage[sensor];
+    if(power != lastPower[sensor]) {
+      writeEvent(timestamp, SENSOR_TRACK_UUID(sensor), TYPE_COUNTER, NULL, &power);
+      lastPower[sensor] = power;
+    }
+  }
+
+  for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
+    if(coreMask & (1 << core)) {
+      std::string name = pcName(sample->pc[core]);
+      if(!sliceOpen[core] || (name != sliceName[core])) {
+        if(sliceOpen[core]) writeEvent(timestamp, CORE_TRACK_UUID(core), TYPE_SLICE_END, NULL, NULL);
+        writeEvent(timestamp, CORE_TRACK_UUID(core), TYPE_SLICE_BEGIN, &name, NULL);
+        sliceOpen[core] = true;
+        sliceName[core] = name;
+      }
+    }
+  }
+}
+
+void TraceWriter::finish() {
+  for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
+    if(sliceOpen[core]) {
+      writeEvent(lastTimestamp, CORE_TRACK_UUID(core), TYPE_SLICE_END, NULL, NULL);
+      sliceOpen[core] = false;
+    }
+  }
+  out.flush();
+}
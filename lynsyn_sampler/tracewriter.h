@@ -0,0 +1,89 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef TRACEWRITER_H
+#define TRACEWRITER_H
+
+#include <string>
+#include <map>
+
+#include "samplewriter.h"
+#include "symboltable.h"
+
+/** Minimal protobuf encoder, enough for writing Perfetto trace packets */
+class ProtoBuffer {
+public:
+  std::string buf;
+
+  void clear() { buf.clear(); }
+  void addVarint(uint64_t val);
+  void addTag(unsigned field, unsigned wireType) { addVarint((field << 3) | wireType); }
+  void addUint(unsigned field, uint64_t val) {
+    addTag(field, 0);
+    addVarint(val);
+  }
+  void addDouble(unsigned field, double val);
+  void addBytes(unsigned field, const std::string &val) {
+    addTag(field, 2);
+    addVarint(val.size());
+    buf += val;
+  }
+  void addMessage(unsigned field, const ProtoBuffer &msg) { addBytes(field, msg.buf); }
+};
+
+/**
+ * Perfetto trace output (protobuf), loadable in ui.perfetto.dev.
+ *
+ * Power for each sensor is written as a counter track, the PC of each
+ * sampled core as slices on a per core track, and marks as instant events.
+ * Slice names are interned, so each distinct name is only written once.
+ */
+class TraceWriter : public SampleWriter {
+  SymbolTable *symbols;
+  std::map<std::string, uint64_t> internedNames;
+  bool firstPacket;
+
+  bool sliceOpen[LYNSYN_MAX_CORES];
+  std::string sliceName[LYNSYN_MAX_CORES];
+  double lastPower[LYNSYN_MAX_SENSORS];
+  uint64_t lastTimestamp;
+
+  ProtoBuffer packet;
+  ProtoBuffer event;
+  ProtoBuffer scratch;
+
+  uint64_t toNs(int64_t time);
+  void writePacket();
+  void writeTrackDescriptor(uint64_t uuid, std::string name, bool counter);
+  void writeEvent(uint64_t timestamp, uint64_t trackUuid, unsigned type, const std::string *name, double *value);
+  std::string pcName(uint64_t pc);
+
+public:
+  TraceWriter(std::ostream &out, SymbolTable *symbols = NULL) : SampleWriter(out) {
+    this->symbols = symbols;
+  }
+
+  void writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask);
+  void writeSample(struct LynsynSample *sample);
+  void finish();
+};
+
+#endif
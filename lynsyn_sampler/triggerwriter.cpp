@@ -0,0 +1,147 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "triggerwriter.h"
+
+volatile sig_atomic_t TriggerWriter::externalTrigger = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+
+void SampleRing::push(struct LynsynSample *sample) {
+  if(count == buf.size()) {
+    // full, double the size and unwrap
+    std::vector<struct LynsynSample> newBuf(buf.size() * 2);
+    for(size_t i = 0; i < count; i++) {
+      newBuf[i] = *at(i);
+    }
+    buf.swap(newBuf);
+    head = 0;
+  }
+  buf[(head + count) % buf.size()] = *sample;
+  count++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+TriggerWriter::TriggerWriter(SampleWriter *writer, std::vector<struct TriggerCondition> &conditions, double preSeconds, double postSeconds) : SampleWriter(writer->stream()) {
+  this->writer = writer;
+  this->conditions = conditions;
+  preCycles = lynsyn_secondsToCycles(preSeconds);
+  postCycles = lynsyn_secondsToCycles(postSeconds);
+}
+
+bool TriggerWriter::checkTrigger(struct LynsynSample *sample) {
+  bool fired = false;
+
+  for(auto condition : conditions) {
+    switch(condition.type) {
+      case TriggerCondition::POWER:
+        if(!(sample->flags & (SAMPLE_FLAG_MARK | SAMPLE_FLAG_GAP))) {
+          for(unsigned sensor = 0; sensor < sensors; sensor++) {
+            if((condition.sensor == -1) || (condition.sensor == (int)sensor)) {
+              if(sample->current[sensor] * sample->voltage[sensor] > condition.power) fired = true;
+            }
+          }
+        }
+        break;
+      case TriggerCondition::MARK:
+        if(sample->flags & SAMPLE_FLAG_MARK) fired = true;
+        break;
+      case TriggerCondition::SIGNAL:
+        if(externalTrigger) {
+          externalTrigger = 0;
+          fired = true;
+        }
+        break;
+    }
+  }
+
+  return fired;
+}
+
+void TriggerWriter::forward(struct LynsynSample *sample) {
+  writer->writeSample(sample);
+
+  // where sampling continued, after a mark or gap that is pc[0]
+  lastWritten = (sample->flags & (SAMPLE_FLAG_MARK | SAMPLE_FLAG_GAP)) ? sample->pc[0] : sample->time;
+}
+
+void TriggerWriter::writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask) {
+  SampleWriter::writeHeader(sensors, cores, coreMask);
+  writer->writeHeader(sensors, cores, coreMask);
+
+  ring.clear();
+  triggered = false;
+  postEnd = 0;
+  lastWritten = -1;
+  events = 0;
+}
+
+void TriggerWriter::writeSample(struct LynsynSample *sample) {
+  bool fired = checkTrigger(sample);
+
+  if(triggered) {
+    forward(sample);
+    if(fired) postEnd = sample->time + postCycles;
+    else if(sample->time > postEnd) triggered = false;
+
+  } else {
+    ring.push(sample);
+    while(ring.front()->time < sample->time - preCycles) {
+      ring.popFront();
+    }
+
+    if(fired) {
+      printf("Trigger at %fs\n", lynsyn_cyclesToSeconds(sample->time));
+      fflush(stdout);
+
+      // the samples between the previous window and this one are not
+      // written, which the wrapped writer must not count as sampled time
+      if(lastWritten != -1) {
+        struct LynsynSample gap;
+        memset(&gap, 0, sizeof(gap));
+        gap.flags = SAMPLE_FLAG_GAP;
+        gap.time = lastWritten;
+        gap.pc[0] = ring.front()->time;
+        forward(&gap);
+      }
+
+      for(size_t i = 0; i < ring.size(); i++) {
+        forward(ring.at(i));
+      }
+      ring.clear();
+
+      triggered = true;
+      postEnd = sample->time + postCycles;
+      events++;
+    }
+  }
+}
+
+void TriggerWriter::finish() {
+  writer->finish();
+
+  printf("%u trigger events\n", events);
+  fflush(stdout);
+}
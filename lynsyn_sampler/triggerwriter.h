@@ -0,0 +1,97 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef TRIGGERWRITER_H
+#define TRIGGERWRITER_H
+
+#include <signal.h>
+#include <vector>
+
+#include "samplewriter.h"
+
+/** Growable circular buffer of samples */
+class SampleRing {
+  std::vector<struct LynsynSample> buf;
+  size_t head;
+  size_t count;
+
+public:
+  SampleRing(size_t capacity = 1024) : buf(capacity) {
+    head = 0;
+    count = 0;
+  }
+
+  size_t size() { return count; }
+  void clear() {
+    head = 0;
+    count = 0;
+  }
+  struct LynsynSample *at(size_t i) { return &buf[(head + i) % buf.size()]; }
+  struct LynsynSample *front() { return at(0); }
+  void popFront() {
+    head = (head + 1) % buf.size();
+    count--;
+  }
+  void push(struct LynsynSample *sample);
+};
+
+struct TriggerCondition {
+  enum { POWER, MARK, SIGNAL } type;
+  int sensor; // -1 means any sensor
+  double power;
+};
+
+/**
+ * Keeps the most recent samples in memory and only passes samples on to the
+ * wrapped writer around trigger events.  When a trigger fires, the buffered
+ * pre-trigger window is written, followed by all samples until the
+ * post-trigger window has passed without another trigger.
+ */
+class TriggerWriter : public SampleWriter {
+  SampleWriter *writer;
+  std::vector<struct TriggerCondition> conditions;
+  int64_t preCycles;
+  int64_t postCycles;
+
+  SampleRing ring;
+  bool triggered;
+  int64_t postEnd;
+  int64_t lastWritten;
+  unsigned events;
+
+  bool checkTrigger(struct LynsynSample *sample);
+  void forward(struct LynsynSample *sample);
+
+public:
+  /** Set from a signal handler to trigger externally */
+  static volatile sig_atomic_t externalTrigger;
+
+  TriggerWriter(SampleWriter *writer, std::vector<struct TriggerCondition> &conditions, double preSeconds, double postSeconds);
+  ~TriggerWriter() {
+    delete writer;
+  }
+
+  void writeHeader(unsigned sensors, unsigned cores, uint64_t coreMask);
+  void writeSample(struct LynsynSample *sample);
+  void finish();
+};
+
+#endif
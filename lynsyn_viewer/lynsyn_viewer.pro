@@ -2,9 +2,9 @@ QT += widgets sql
 QMAKE_CXXFLAGS += -std=gnu++2a -Wno-unused-parameter -Wno-deprecated-copy
 
 HEADERS = $$files(src/*.h, true)
-SOURCES = $$files(src/*.cpp, true) ../liblynsyn/lynsyn.c
+SOURCES = $$files(src/*.cpp, true) ../liblynsyn/lynsyn.c ../lynsyn_sampler/compress.cpp
 
-INCLUDEPATH += src /usr/include/libusb-1.0/ ../common/ ../liblynsyn/ /mingw64/include/libusb-1.0/
+INCLUDEPATH += src /usr/include/libusb-1.0/ ../common/ ../liblynsyn/ ../lynsyn_sampler/ /mingw64/include/libusb-1.0/
 
 RESOURCES     = application.qrc
 
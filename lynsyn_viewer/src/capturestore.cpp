@@ -0,0 +1,421 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <string.h>
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include <QHash>
+#include <QFileInfo>
+
+#include "capturestore.h"
+#include "compress.h"
+
+static uint64_t align(uint64_t offset) {
+  return (offset + 7) & ~7ull;
+}
+
+// true if an aligned array of count elements at offset fits in the file
+static bool inFile(const struct StoreHeader *header, uint64_t offset, uint64_t count, uint64_t size) {
+  if((offset % 8) || (offset < sizeof(struct StoreHeader)) || (offset > header->size)) return false;
+  return count <= (header->size - offset) / size;
+}
+
+static bool validHeader(const struct StoreHeader *header) {
+  uint64_t samples = header->samples;
+
+  if(!inFile(header, header->timeOffset, samples, sizeof(int64_t))) return false;
+  if(!inFile(header, header->cumTimeOffset, samples, sizeof(int64_t))) return false;
+  for(unsigned sensor = 0; sensor < header->sensors; sensor++) {
+    if(!inFile(header, header->currentOffset[sensor], samples, sizeof(float))) return false;
+    if(!inFile(header, header->voltageOffset[sensor], samples, sizeof(float))) return false;
+    if(!inFile(header, header->cumEnergyOffset[sensor], samples, sizeof(double))) return false;
+  }
+  for(unsigned core = 0; core < header->cores; core++) {
+    if(!inFile(header, header->symbolOffset[core], samples, sizeof(uint32_t))) return false;
+  }
+  if(!inFile(header, header->markOffset, header->marks, sizeof(struct StoreMark))) return false;
+  if(!inFile(header, header->aggregateOffset, header->aggregates, sizeof(struct StoreAggregate))) return false;
+
+  // the names are checked while they are read
+  return inFile(header, header->nameOffset, 0, 1);
+}
+
+CaptureStore::CaptureStore() {
+  map = NULL;
+  header = NULL;
+}
+
+CaptureStore::~CaptureStore() {
+  close();
+}
+
+bool CaptureStore::isCapture(QString filename) {
+  QFile f(filename);
+  if(!f.open(QIODevice::ReadOnly)) return false;
+
+  uint8_t buf[CAPTURE_HEADER_SIZE];
+  if(f.read((char*)buf, sizeof(buf)) != sizeof(buf)) return false;
+
+  struct CaptureHeader header;
+  decodeCaptureHeader(buf, &header);
+
+  return header.magic == CAPTURE_MAGIC;
+}
+
+bool CaptureStore::convert(QString captureFilename, QString storeFilename, ElfSupport &elfSupport) {
+  struct StoreHeader h;
+  memset(&h, 0, sizeof(h));
+
+  h.magic = STORE_MAGIC;
+  h.version = STORE_VERSION;
+
+  // stored core n is the nth core in the capture core mask
+  unsigned pcIndex[LYNSYN_MAX_CORES];
+  std::set<uint64_t> pcs[LYNSYN_MAX_CORES];
+
+  struct LynsynSample sample;
+
+  { // first pass: sizes, limits and the distinct PCs
+    CaptureReader reader;
+    if(!reader.open(captureFilename.toLocal8Bit().constData())) return false;
+
+    h.sensors = reader.header.sensors;
+    if(h.sensors > LYNSYN_MAX_SENSORS) h.sensors = LYNSYN_MAX_SENSORS;
+
+    for(unsigned i = 0; i < LYNSYN_MAX_CORES; i++) {
+      if(reader.header.coreMask & (1 << i)) pcIndex[h.cores++] = i;
+    }
+
+    h.minTime = -1;
+
+    while(reader.next(&sample)) {
+      if(sample.flags & SAMPLE_FLAG_GAP) continue;
+
+      if(sample.flags & SAMPLE_REPLY_FLAG_MARK) {
+        h.marks++;
+        continue;
+      }
+
+      if(h.minTime == -1) h.minTime = sample.time;
+      h.maxTime = sample.time;
+
+      for(unsigned sensor = 0; sensor < h.sensors; sensor++) {
+        double value[3] = { sample.current[sensor], sample.voltage[sensor], sample.current[sensor] * sample.voltage[sensor] };
+        for(unsigned i = 0; i < 3; i++) {
+          if(!h.samples || (value[i] < h.min[sensor][i])) h.min[sensor][i] = value[i];
+          if(!h.samples || (value[i] > h.max[sensor][i])) h.max[sensor][i] = value[i];
+        }
+      }
+
+      for(unsigned core = 0; core < h.cores; core++) {
+        pcs[core].insert((sample.pc[pcIndex[core]] >> 2) << 2);
+      }
+
+      h.samples++;
+    }
+  }
+
+  // symbolize each distinct PC once
+  QHash<uint64_t, uint32_t> pcSymbols;
+  QHash<QString, uint32_t> ids;
+  QVector<QByteArray> names;
+  for(unsigned core = 0; core < h.cores; core++) {
+    for(auto pc : pcs[core]) {
+      if(pcSymbols.contains(pc)) continue;
+
+      QFileInfo info(elfSupport.getFilename(pc));
+      QString name = info.fileName() + ":" + elfSupport.getFunction(pc);
+
+      auto it = ids.constFind(name);
+      if(it != ids.constEnd()) {
+        pcSymbols[pc] = *it;
+      } else {
+        pcSymbols[pc] = names.size();
+        ids[name] = names.size();
+        names.push_back(name.toUtf8());
+      }
+    }
+  }
+  h.symbols = names.size();
+
+  // one aggregate per symbol seen on each core, and the one for cores not
+  // in the capture last
+  std::set<std::pair<uint32_t, uint32_t> > aggregateKeys;
+  for(unsigned core = 0; core < h.cores; core++) {
+    for(auto pc : pcs[core]) {
+      aggregateKeys.insert(std::make_pair(core, pcSymbols.value(pc)));
+    }
+  }
+  aggregateKeys.insert(std::make_pair(h.cores, (uint32_t)h.symbols));
+  h.aggregates = aggregateKeys.size();
+
+  // layout
+  uint64_t offset = align(sizeof(h));
+  h.timeOffset = offset;
+  offset = align(offset + h.samples * sizeof(int64_t));
+  h.cumTimeOffset = offset;
+  offset = align(offset + h.samples * sizeof(int64_t));
+  for(unsigned sensor = 0; sensor < h.sensors; sensor++) {
+    h.currentOffset[sensor] = offset;
+    offset = align(offset + h.samples * sizeof(float));
+    h.voltageOffset[sensor] = offset;
+    offset = align(offset + h.samples * sizeof(float));
+    h.cumEnergyOffset[sensor] = offset;
+    offset = align(offset + h.samples * sizeof(double));
+  }
+  for(unsigned core = 0; core < h.cores; core++) {
+    h.symbolOffset[core] = offset;
+    offset = align(offset + h.samples * sizeof(uint32_t));
+  }
+  h.markOffset = offset;
+  offset = align(offset + h.marks * sizeof(struct StoreMark));
+  h.aggregateOffset = offset;
+  offset = align(offset + h.aggregates * sizeof(struct StoreAggregate));
+  h.nameOffset = offset;
+  for(auto name : names) {
+    offset += sizeof(uint32_t) + name.size();
+  }
+  h.size = offset;
+
+  // written to a temporary file which is renamed when complete, so an
+  // interrupted conversion never leaves a store that looks up to date
+  QFile out(storeFilename + ".tmp");
+  if(!out.open(QIODevice::ReadWrite | QIODevice::Truncate)) return false;
+  if(!out.resize(h.size)) {
+    out.remove();
+    return false;
+  }
+  uchar *outMap = out.map(0, h.size);
+  if(!outMap) {
+    out.remove();
+    return false;
+  }
+
+  { // second pass: fill in the columns
+    CaptureReader reader;
+    if(!reader.open(captureFilename.toLocal8Bit().constData())) {
+      out.unmap(outMap);
+      out.remove();
+      return false;
+    }
+
+    int64_t *time = (int64_t*)(outMap + h.timeOffset);
+    int64_t *cumTime = (int64_t*)(outMap + h.cumTimeOffset);
+    struct StoreMark *marks = (struct StoreMark*)(outMap + h.markOffset);
+    struct StoreAggregate *aggregates = (struct StoreAggregate*)(outMap + h.aggregateOffset);
+
+    // aggregate of each symbol per core, the last one for the missing cores
+    std::vector<uint64_t> aggregateIndex[LYNSYN_MAX_CORES];
+    for(unsigned core = 0; core < h.cores; core++) {
+      aggregateIndex[core].resize(h.symbols);
+    }
+    uint64_t index = 0;
+    for(auto key : aggregateKeys) {
+      memset(&aggregates[index], 0, sizeof(struct StoreAggregate));
+      aggregates[index].core = key.first;
+      aggregates[index].symbol = key.second;
+      if(key.first < h.cores) aggregateIndex[key.first][key.second] = index;
+      index++;
+    }
+    struct StoreAggregate *unknown = &aggregates[h.aggregates - 1];
+
+    uint64_t i = 0;
+    uint64_t mark = 0;
+    int64_t lastTime = -1;
+    int64_t cumulativeTime = 0;
+    double energy[LYNSYN_MAX_SENSORS] = { 0 };
+
+    while(reader.next(&sample) && (i < h.samples)) {
+      if(sample.flags & SAMPLE_FLAG_GAP) {
+        // nothing was sampled until pc[0]
+        lastTime = sample.pc[0];
+        continue;
+      }
+
+      if(sample.flags & SAMPLE_REPLY_FLAG_MARK) {
+        if(mark < h.marks) {
+          marks[mark].time = sample.time;
+          marks[mark].delay = (int64_t)sample.pc[0] - sample.time;
+          mark++;
+        }
+        lastTime = sample.pc[0];
+        continue;
+      }
+
+      int64_t timeSinceLast = (lastTime == -1) ? 0 : sample.time - lastTime;
+      lastTime = sample.time;
+      cumulativeTime += timeSinceLast;
+
+      time[i] = sample.time;
+      cumTime[i] = cumulativeTime;
+
+      double power[LYNSYN_MAX_SENSORS];
+      double seconds = lynsyn_cyclesToSeconds(timeSinceLast);
+
+      for(unsigned sensor = 0; sensor < h.sensors; sensor++) {
+        power[sensor] = sample.current[sensor] * sample.voltage[sensor];
+        energy[sensor] += power[sensor] * seconds;
+        ((float*)(outMap + h.currentOffset[sensor]))[i] = sample.current[sensor];
+        ((float*)(outMap + h.voltageOffset[sensor]))[i] = sample.voltage[sensor];
+        ((double*)(outMap + h.cumEnergyOffset[sensor]))[i] = energy[sensor];
+      }
+
+      for(unsigned core = 0; core <= h.cores; core++) {
+        struct StoreAggregate *aggregate = unknown;
+
+        if(core < h.cores) {
+          uint32_t symbol = pcSymbols.value((sample.pc[pcIndex[core]] >> 2) << 2);
+          ((uint32_t*)(outMap + h.symbolOffset[core]))[i] = symbol;
+          aggregate = &aggregates[aggregateIndex[core][symbol]];
+        }
+
+        aggregate->samples++;
+        aggregate->runtime += seconds;
+        for(unsigned sensor = 0; sensor < h.sensors; sensor++) {
+          aggregate->power[sensor] += power[sensor];
+          aggregate->energy[sensor] += power[sensor] * seconds;
+        }
+      }
+
+      i++;
+    }
+
+    // power is summed per sample above, and stored as the mean
+    for(uint64_t a = 0; a < h.aggregates; a++) {
+      if(aggregates[a].samples) {
+        for(unsigned sensor = 0; sensor < h.sensors; sensor++) {
+          aggregates[a].power[sensor] /= aggregates[a].samples;
+        }
+      }
+    }
+  }
+
+  uchar *p = outMap + h.nameOffset;
+  for(auto name : names) {
+    uint32_t length = name.size();
+    memcpy(p, &length, sizeof(length));
+    memcpy(p + sizeof(length), name.constData(), length);
+    p += sizeof(length) + length;
+  }
+
+  memcpy(outMap, &h, sizeof(h));
+
+  out.unmap(outMap);
+  out.close();
+
+  QFile::remove(storeFilename);
+  if(!out.rename(storeFilename)) {
+    out.remove();
+    return false;
+  }
+
+  return true;
+}
+
+bool CaptureStore::open(QString filename) {
+  close();
+
+  file.setFileName(filename);
+  if(!file.open(QIODevice::ReadOnly)) return false;
+
+  if(file.size() < (qint64)sizeof(struct StoreHeader)) {
+    close();
+    return false;
+  }
+
+  map = file.map(0, file.size());
+  if(!map) {
+    close();
+    return false;
+  }
+
+  header = (const struct StoreHeader*)map;
+  if((header->magic != STORE_MAGIC) || (header->version != STORE_VERSION) || (header->size != (uint64_t)file.size()) ||
+     (header->sensors > LYNSYN_MAX_SENSORS) || (header->cores > LYNSYN_MAX_CORES) || !validHeader(header)) {
+    close();
+    return false;
+  }
+
+  time = (const int64_t*)(map + header->timeOffset);
+  cumTime = (const int64_t*)(map + header->cumTimeOffset);
+  for(unsigned sensor = 0; sensor < header->sensors; sensor++) {
+    current[sensor] = (const float*)(map + header->currentOffset[sensor]);
+    voltage[sensor] = (const float*)(map + header->voltageOffset[sensor]);
+    cumEnergy[sensor] = (const double*)(map + header->cumEnergyOffset[sensor]);
+  }
+  for(unsigned core = 0; core < header->cores; core++) {
+    symbol[core] = (const uint32_t*)(map + header->symbolOffset[core]);
+  }
+  marks = (const struct StoreMark*)(map + header->markOffset);
+  aggregates = (const struct StoreAggregate*)(map + header->aggregateOffset);
+
+  symbolNames.clear();
+  uint64_t pos = header->nameOffset;
+  for(uint64_t i = 0; i < header->symbols; i++) {
+    uint32_t length;
+    if(pos + sizeof(length) > header->size) break;
+    memcpy(&length, map + pos, sizeof(length));
+    pos += sizeof(length);
+    if(pos + length > header->size) break;
+    symbolNames.push_back(QString::fromUtf8((const char*)map + pos, length));
+    pos += length;
+  }
+
+  return true;
+}
+
+void CaptureStore::close() {
+  if(map) file.unmap(map);
+  map = NULL;
+  header = NULL;
+  if(file.isOpen()) file.close();
+  symbolNames.clear();
+}
+
+uint64_t CaptureStore::lowerBound(int64_t t) {
+  return std::lower_bound(time, time + header->samples, t) - time;
+}
+
+uint64_t CaptureStore::upperBound(int64_t t) {
+  return std::upper_bound(time, time + header->samples, t) - time;
+}
+
+double CaptureStore::value(unsigned sensor, MeasurementType type, uint64_t i) {
+  switch(type) {
+    case CURRENT: return current[sensor][i];
+    case VOLTAGE: return voltage[sensor][i];
+    case POWER:   return (double)current[sensor][i] * voltage[sensor][i];
+  }
+  return 0;
+}
+
+bool CaptureStore::rangeStatistics(unsigned sensor, int64_t beginTime, int64_t endTime, double *duration, double *energy) {
+  uint64_t begin = lowerBound(beginTime);
+  uint64_t end = upperBound(endTime);
+  if(begin >= end) return false;
+
+  *duration = lynsyn_cyclesToSeconds(cumTime[end - 1] - cumTime[begin]);
+  *energy = cumEnergy[sensor][end - 1] - cumEnergy[sensor][begin];
+
+  return true;
+}
@@ -0,0 +1,139 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef CAPTURESTORE_H
+#define CAPTURESTORE_H
+
+#include <QString>
+#include <QVector>
+#include <QFile>
+
+#include "lynsyn.h"
+#include "lynsyn_viewer.h"
+#include "elfsupport.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Columnar capture file format
+//
+// A StoreHeader followed by one array per column, each starting on an 8 byte
+// boundary:
+//   time:      int64 per sample, sorted, in cycles
+//   cumtime:   int64 per sample, sum of time since the previous sample
+//   current:   float per sample and sensor
+//   voltage:   float per sample and sensor
+//   cumenergy: double per sample and sensor, running sum of energy in J
+//   symbol:    uint32 per sample and core, index into the symbol names
+//   marks:      StoreMark per mark
+//   aggregates: StoreAggregate per core and symbol seen on that core, sorted
+//               by core and symbol.  Samples of cores not in the capture are
+//               summed in one extra entry with core set to the number of
+//               cores and symbol set to the number of symbols
+//   names:      per symbol a uint32 length followed by a "module:function" string
+//
+// The file is memory mapped, so the graph and the tables read the columns in
+// place.  Samples are found with a binary search on the time column.
+
+// the store is kept next to the capture, named with this suffix
+#define STORE_SUFFIX ".col"
+
+#define STORE_MAGIC 0x534e594c // "LYNS"
+#define STORE_VERSION 2
+
+struct StoreHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t sensors;
+  uint32_t cores;
+  uint64_t samples;
+  uint64_t marks;
+  uint64_t aggregates;
+  uint64_t symbols;
+  uint64_t size;
+  int64_t minTime;
+  int64_t maxTime;
+  double min[LYNSYN_MAX_SENSORS][3];
+  double max[LYNSYN_MAX_SENSORS][3];
+  uint64_t timeOffset;
+  uint64_t cumTimeOffset;
+  uint64_t currentOffset[LYNSYN_MAX_SENSORS];
+  uint64_t voltageOffset[LYNSYN_MAX_SENSORS];
+  uint64_t cumEnergyOffset[LYNSYN_MAX_SENSORS];
+  uint64_t symbolOffset[LYNSYN_MAX_CORES];
+  uint64_t markOffset;
+  uint64_t aggregateOffset;
+  uint64_t nameOffset;
+};
+
+struct StoreMark {
+  int64_t time;
+  int64_t delay;
+};
+
+// runtime in seconds, mean power in W and energy in J
+struct StoreAggregate {
+  uint32_t core;
+  uint32_t symbol;
+  uint64_t samples;
+  double runtime;
+  double power[LYNSYN_MAX_SENSORS];
+  double energy[LYNSYN_MAX_SENSORS];
+};
+
+class CaptureStore {
+  QFile file;
+  uchar *map;
+
+public:
+  const struct StoreHeader *header;
+  const int64_t *time;
+  const int64_t *cumTime;
+  const float *current[LYNSYN_MAX_SENSORS];
+  const float *voltage[LYNSYN_MAX_SENSORS];
+  const double *cumEnergy[LYNSYN_MAX_SENSORS];
+  const uint32_t *symbol[LYNSYN_MAX_CORES];
+  const struct StoreMark *marks;
+  const struct StoreAggregate *aggregates;
+  QVector<QString> symbolNames;
+
+  CaptureStore();
+  ~CaptureStore();
+
+  bool open(QString filename);
+  void close();
+
+  static bool isCapture(QString filename);
+  static bool convert(QString captureFilename, QString storeFilename, ElfSupport &elfSupport);
+
+  uint64_t size() { return header->samples; }
+  unsigned sensors() { return header->sensors; }
+  unsigned cores() { return header->cores; }
+  uint64_t numMarks() { return header->marks; }
+  uint64_t numAggregates() { return header->aggregates; }
+
+  uint64_t lowerBound(int64_t t);
+  uint64_t upperBound(int64_t t);
+  double value(unsigned sensor, MeasurementType type, uint64_t i);
+  int64_t timeSinceLast(uint64_t i) { return i ? cumTime[i] - cumTime[i - 1] : 0; }
+  bool rangeStatistics(unsigned sensor, int64_t beginTime, int64_t endTime, double *duration, double *energy);
+};
+
+#endif
@@ -0,0 +1,205 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <assert.h>
+
+#include <QDir>
+#include <QFile>
+
+#include "catalog.h"
+#include "capturestore.h"
+
+static void removeDatabaseFile(QString filename) {
+  QFile::remove(filename);
+  QFile::remove(filename + "-wal");
+  QFile::remove(filename + "-shm");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+Catalog::Catalog(QString filename) {
+  this->filename = filename;
+}
+
+Catalog::~Catalog() {
+  disconnect();
+}
+
+void Catalog::connect() {
+  QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "catalog");
+  db.setDatabaseName(filename);
+
+  bool success = db.open();
+
+  if(!success) {
+    QSqlError error = db.lastError();
+    printf("Can't open DB: %s\n", error.text().toUtf8().constData());
+    assert(0);
+  }
+
+  QSqlQuery query(db);
+
+  success = query.exec("CREATE TABLE IF NOT EXISTS captures (id INTEGER PRIMARY KEY, name TEXT, filename TEXT, store INT, "
+                       "date INT, board TEXT, elfs TEXT, kallsyms TEXT, samples INT, duration REAL)");
+  Q_UNUSED(success);
+  assert(success);
+}
+
+void Catalog::disconnect() {
+  {
+    QSqlDatabase db = QSqlDatabase::database("catalog");
+    db.close();
+  }
+  QSqlDatabase::removeDatabase("catalog");
+}
+
+bool Catalog::readEntry(QSqlQuery &query, CatalogEntry *entry) {
+  if(!query.next()) return false;
+
+  entry->id = query.value(0).toInt();
+  entry->name = query.value(1).toString();
+  entry->filename = query.value(2).toString();
+  entry->store = query.value(3).toBool();
+  entry->date = QDateTime::fromMSecsSinceEpoch(query.value(4).toLongLong());
+  entry->board = query.value(5).toString();
+  entry->elfFilenames.clear();
+  for(auto elf : query.value(6).toString().split(',')) {
+    if(!elf.simplified().isEmpty()) entry->elfFilenames << elf;
+  }
+  entry->kallsyms = query.value(7).toString();
+  entry->samples = query.value(8).toULongLong();
+  entry->duration = query.value(9).toDouble();
+
+  return true;
+}
+
+QVector<CatalogEntry> Catalog::entries() {
+  QSqlDatabase db = QSqlDatabase::database("catalog");
+  QSqlQuery query(db);
+
+  QVector<CatalogEntry> entries;
+
+  query.exec("SELECT id,name,filename,store,date,board,elfs,kallsyms,samples,duration FROM captures ORDER BY date DESC, id DESC");
+
+  CatalogEntry entry;
+  while(readEntry(query, &entry)) {
+    entries.push_back(entry);
+  }
+
+  return entries;
+}
+
+bool Catalog::entry(int id, CatalogEntry *entry) {
+  QSqlDatabase db = QSqlDatabase::database("catalog");
+  QSqlQuery query(db);
+
+  query.prepare("SELECT id,name,filename,store,date,board,elfs,kallsyms,samples,duration FROM captures WHERE id = ?");
+  query.bindValue(0, id);
+  query.exec();
+
+  return readEntry(query, entry);
+}
+
+int Catalog::find(QString filename) {
+  QSqlDatabase db = QSqlDatabase::database("catalog");
+  QSqlQuery query(db);
+
+  query.prepare("SELECT id FROM captures WHERE filename = ?");
+  query.bindValue(0, filename);
+  query.exec();
+
+  if(query.next()) return query.value(0).toInt();
+  return -1;
+}
+
+bool Catalog::create(QString name, bool store, QString filename, QString board, QStringList elfFilenames, QString kallsyms, CatalogEntry *entry) {
+  QSqlDatabase db = QSqlDatabase::database("catalog");
+  QSqlQuery query(db);
+
+  query.prepare("INSERT INTO captures (name, filename, store, date, board, elfs, kallsyms, samples, duration) "
+                "VALUES (?, ?, ?, ?, ?, ?, ?, 0, 0)");
+  query.bindValue(0, name);
+  query.bindValue(1, filename);
+  query.bindValue(2, store);
+  query.bindValue(3, QDateTime::currentMSecsSinceEpoch());
+  query.bindValue(4, board);
+  query.bindValue(5, elfFilenames.join(','));
+  query.bindValue(6, kallsyms);
+
+  if(!query.exec()) {
+    printf("SQL Error: %s\n", query.lastError().text().toUtf8().constData());
+    return false;
+  }
+
+  int id = query.lastInsertId().toInt();
+
+  // profile databases are named after the catalog id
+  if(!store) {
+    QDir().mkpath(CATALOG_DIRECTORY);
+    filename = QString(CATALOG_DIRECTORY) + "/capture" + QString::number(id) + ".db";
+    removeDatabaseFile(filename);
+
+    query.prepare("UPDATE captures SET filename = ? WHERE id = ?");
+    query.bindValue(0, filename);
+    query.bindValue(1, id);
+
+    if(!query.exec()) {
+      printf("SQL Error: %s\n", query.lastError().text().toUtf8().constData());
+      return false;
+    }
+  }
+
+  return this->entry(id, entry);
+}
+
+bool Catalog::update(int id, uint64_t samples, double duration) {
+  QSqlDatabase db = QSqlDatabase::database("catalog");
+  QSqlQuery query(db);
+
+  query.prepare("UPDATE captures SET samples = ?, duration = ? WHERE id = ?");
+  query.bindValue(0, (qint64)samples);
+  query.bindValue(1, duration);
+  query.bindValue(2, id);
+
+  if(!query.exec()) {
+    printf("SQL Error: %s\n", query.lastError().text().toUtf8().constData());
+    return false;
+  }
+
+  return true;
+}
+
+void Catalog::remove(int id) {
+  CatalogEntry entry;
+  if(!this->entry(id, &entry)) return;
+
+  QSqlDatabase db = QSqlDatabase::database("catalog");
+  QSqlQuery query(db);
+
+  query.prepare("DELETE FROM captures WHERE id = ?");
+  query.bindValue(0, id);
+  query.exec();
+
+  // compressed captures belong to the user, only our own files are removed
+  if(entry.store) QFile::remove(entry.filename + STORE_SUFFIX);
+  else removeDatabaseFile(entry.filename);
+}
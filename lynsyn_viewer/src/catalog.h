@@ -0,0 +1,76 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QVector>
+#include <QtSql>
+
+#define CATALOG_FILENAME "lynsyn_catalog.db"
+#define CATALOG_DIRECTORY "lynsyn_captures"
+
+class CatalogEntry {
+public:
+  int id;
+  QString name;
+  QString filename; // profile database, or the compressed capture for stores
+  bool store;
+  QDateTime date;
+  QString board;
+  QStringList elfFilenames;
+  QString kallsyms;
+  uint64_t samples;
+  double duration;
+};
+
+/**
+ * Keeps track of all captures made or imported by the viewer.  Each capture
+ * is a separate profile database in CATALOG_DIRECTORY with its own pyramid
+ * and aggregates, so switching capture is only a matter of opening another
+ * file.  Compressed captures opened as a CaptureStore are listed with the
+ * path of the capture itself.
+ */
+class Catalog {
+  QString filename;
+
+  bool readEntry(QSqlQuery &query, CatalogEntry *entry);
+
+public:
+  Catalog(QString filename);
+  ~Catalog();
+
+  void connect();
+  void disconnect();
+
+  QVector<CatalogEntry> entries();
+  bool entry(int id, CatalogEntry *entry);
+  int find(QString filename);
+
+  bool create(QString name, bool store, QString filename, QString board, QStringList elfFilenames, QString kallsyms, CatalogEntry *entry);
+  bool update(int id, uint64_t samples, double duration);
+  void remove(int id);
+};
+
+#endif
@@ -0,0 +1,305 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <string.h>
+#include <math.h>
+
+#include "csvreader.h"
+
+///////////////////////////////////////////////////////////////////////////////
+
+// powers of ten that are exact in a double
+static const double exactPowers[] = {
+  1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+#define NUM_EXACT_POWERS (sizeof(exactPowers) / sizeof(exactPowers[0]))
+
+static double power10(int exponent) {
+  if((unsigned)exponent < NUM_EXACT_POWERS) return exactPowers[exponent];
+  return pow(10, exponent);
+}
+
+static bool isDigit(char c) {
+  return (c >= '0') && (c <= '9');
+}
+
+// locale independent, the sampler always writes '.' as decimal point
+static const char *parseDouble(const char *p, const char *end, double *val) {
+  bool negative = false;
+  if((p < end) && ((*p == '-') || (*p == '+'))) {
+    negative = *p == '-';
+    p++;
+  }
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  unsigned digits = 0;
+
+  while((p < end) && isDigit(*p)) {
+    if(mantissa < 100000000000000000ull) mantissa = mantissa * 10 + (*p - '0');
+    else exponent++;
+    p++;
+    digits++;
+  }
+  if((p < end) && (*p == '.')) {
+    p++;
+    while((p < end) && isDigit(*p)) {
+      if(mantissa < 100000000000000000ull) {
+        mantissa = mantissa * 10 + (*p - '0');
+        exponent--;
+      }
+      p++;
+      digits++;
+    }
+  }
+  if(!digits) return NULL;
+
+  if((p < end) && ((*p == 'e') || (*p == 'E'))) {
+    p++;
+    bool negativeExponent = false;
+    if((p < end) && ((*p == '-') || (*p == '+'))) {
+      negativeExponent = *p == '-';
+      p++;
+    }
+    if((p >= end) || !isDigit(*p)) return NULL;
+    int e = 0;
+    while((p < end) && isDigit(*p)) {
+      if(e < 10000) e = e * 10 + (*p - '0');
+      p++;
+    }
+    exponent += negativeExponent ? -e : e;
+  }
+
+  double v = mantissa;
+  if(exponent < 0) v /= power10(-exponent);
+  else if(exponent > 0) v *= power10(exponent);
+
+  *val = negative ? -v : v;
+  return p;
+}
+
+static const char *parseUnsigned(const char *p, const char *end, uint64_t *val) {
+  if((p >= end) || !isDigit(*p)) return NULL;
+  uint64_t v = 0;
+  while((p < end) && isDigit(*p)) {
+    v = v * 10 + (*p - '0');
+    p++;
+  }
+  *val = v;
+  return p;
+}
+
+static const char *separator(const char *p, const char *end) {
+  if(!p || (p >= end) || (*p != ';')) return NULL;
+  return p + 1;
+}
+
+static bool isBlank(const char *p, const char *end) {
+  while(p < end) {
+    if((*p != ' ') && (*p != '\t') && (*p != '\r')) return false;
+    p++;
+  }
+  return true;
+}
+
+static const char *lineEnd(const char *p, const char *end) {
+  const char *eol = (const char*)memchr(p, '\n', end - p);
+  return eol ? eol : end;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+CsvReader::CsvReader() {
+  data = NULL;
+  dataSize = 0;
+  numSensors = 0;
+  numCores = 0;
+  nextChunk = 0;
+  nextConsumed = 0;
+  window = 0;
+  stopped = false;
+}
+
+CsvReader::~CsvReader() {
+  stop();
+  file.close();
+}
+
+bool CsvReader::parseLine(const char *p, const char *end, CsvRow *row) {
+  double time;
+  p = parseDouble(p, end, &time);
+  if(!p) return false;
+  row->time = lynsyn_secondsToCycles(time);
+
+  for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
+    p = separator(p, end);
+    if(p) p = parseUnsigned(p, end, &row->pc[core]);
+    if(!p) return false;
+  }
+  for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
+    p = separator(p, end);
+    if(p) p = parseDouble(p, end, &row->current[sensor]);
+    if(!p) return false;
+  }
+  for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
+    p = separator(p, end);
+    if(p) p = parseDouble(p, end, &row->voltage[sensor]);
+    if(!p) return false;
+  }
+
+  return isBlank(p, end);
+}
+
+bool CsvReader::open(QString filename) {
+  file.setFileName(filename);
+  if(!file.open(QIODevice::ReadOnly)) return false;
+
+  dataSize = file.size();
+  if(!dataSize) return false;
+
+  data = (const char*)file.map(0, dataSize);
+  if(!data) return false;
+
+  const char *end = data + dataSize;
+
+  // header: a comment line, "sensors;cores" and the column names
+  const char *p = lineEnd(data, end);
+  if(p >= end) return false;
+  p++;
+
+  const char *eol = lineEnd(p, end);
+  uint64_t sensors;
+  uint64_t cores;
+  p = parseUnsigned(p, eol, &sensors);
+  p = separator(p, eol);
+  if(p) p = parseUnsigned(p, eol, &cores);
+  if(!p || !isBlank(p, eol)) return false;
+  if((sensors > LYNSYN_MAX_SENSORS) || (cores > LYNSYN_MAX_CORES)) return false;
+  numSensors = sensors;
+  numCores = cores;
+
+  p = lineEnd(eol + 1 < end ? eol + 1 : end, end);
+  if(p < end) p++;
+
+  // body, split into chunks ending on a line boundary
+  chunks.clear();
+  while(p < end) {
+    CsvChunk chunk;
+    chunk.begin = p;
+    chunk.end = end;
+    if(end - p > CSV_CHUNK_SIZE) chunk.end = lineEnd(p + CSV_CHUNK_SIZE, end);
+    chunk.ready = false;
+    chunk.error = false;
+    chunks.push_back(chunk);
+
+    p = chunk.end;
+    if(p < end) p++;
+  }
+
+  return true;
+}
+
+void CsvReader::work() {
+  while(true) {
+    size_t c;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      consumed.wait(lock, [this] {
+        return stopped || (nextChunk >= chunks.size()) || (nextChunk < nextConsumed + window);
+      });
+      if(stopped || (nextChunk >= chunks.size())) return;
+      c = nextChunk++;
+    }
+
+    CsvChunk &chunk = chunks[c];
+    std::vector<CsvRow> rows;
+    bool error = false;
+
+    const char *p = chunk.begin;
+    while(p < chunk.end) {
+      const char *eol = lineEnd(p, chunk.end);
+      if(!isBlank(p, eol)) {
+        CsvRow row;
+        if(!parseLine(p, eol, &row)) {
+          error = true;
+          break;
+        }
+        rows.push_back(row);
+      }
+      p = eol + 1;
+    }
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      chunk.rows.swap(rows);
+      chunk.error = error;
+      chunk.ready = true;
+    }
+    parsed.notify_all();
+  }
+}
+
+void CsvReader::start(unsigned threads) {
+  if(threads < 1) threads = 1;
+
+  nextChunk = 0;
+  nextConsumed = 0;
+  window = threads * CSV_CHUNKS_PER_WORKER;
+  stopped = false;
+
+  for(unsigned i = 0; i < threads; i++) {
+    workers.push_back(std::thread(&CsvReader::work, this));
+  }
+}
+
+void CsvReader::stop() {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    stopped = true;
+  }
+  consumed.notify_all();
+
+  for(auto &worker : workers) {
+    worker.join();
+  }
+  workers.clear();
+}
+
+bool CsvReader::next(std::vector<CsvRow> &rows, bool *error) {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  if(nextConsumed >= chunks.size()) return false;
+
+  CsvChunk &chunk = chunks[nextConsumed];
+  parsed.wait(lock, [&chunk] { return chunk.ready; });
+
+  rows.clear();
+  rows.swap(chunk.rows);
+  *error = chunk.error;
+  nextConsumed++;
+
+  lock.unlock();
+  consumed.notify_all();
+
+  return true;
+}
@@ -0,0 +1,101 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef CSVREADER_H
+#define CSVREADER_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include <QString>
+#include <QFile>
+
+#include "lynsyn.h"
+
+// bytes of CSV text parsed by a worker in one go
+#define CSV_CHUNK_SIZE (1024 * 1024)
+
+// parsed chunks kept ahead of the consumer, per worker
+#define CSV_CHUNKS_PER_WORKER 2
+
+class CsvRow {
+public:
+  int64_t time;
+  uint64_t pc[LYNSYN_MAX_CORES];
+  double current[LYNSYN_MAX_SENSORS];
+  double voltage[LYNSYN_MAX_SENSORS];
+};
+
+class CsvChunk {
+public:
+  const char *begin;
+  const char *end;
+  bool ready;
+  bool error;
+  std::vector<CsvRow> rows;
+};
+
+/**
+ * Reads a lynsyn_sampler CSV file with a pool of parser threads.  The file is
+ * memory mapped and split into newline aligned chunks, the workers parse
+ * chunks in parallel, and the consumer gets the parsed chunks back in file
+ * order from next().
+ */
+class CsvReader {
+  QFile file;
+  const char *data;
+  qint64 dataSize;
+  unsigned numSensors;
+  unsigned numCores;
+
+  std::vector<CsvChunk> chunks;
+  std::vector<std::thread> workers;
+  std::mutex mutex;
+  std::condition_variable parsed;
+  std::condition_variable consumed;
+  size_t nextChunk;
+  size_t nextConsumed;
+  size_t window;
+  bool stopped;
+
+  void work();
+  static bool parseLine(const char *p, const char *end, CsvRow *row);
+
+public:
+  CsvReader();
+  ~CsvReader();
+
+  bool open(QString filename);
+  void start(unsigned threads = std::thread::hardware_concurrency());
+  void stop();
+
+  bool next(std::vector<CsvRow> &rows, bool *error);
+
+  unsigned sensors() { return numSensors; }
+  unsigned cores() { return numCores; }
+  size_t size() { return chunks.size(); }
+  size_t position() { return nextConsumed; }
+};
+
+#endif
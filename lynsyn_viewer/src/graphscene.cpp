@@ -22,6 +22,7 @@
 #include "graphscene.h"
 #include "config.h"
 #include "profmodel.h"
+#include "pyramid.h"
 
 #define GANTT_SPACING 20
 #define GRAPH_SIZE (scaleFactorMeasurement + GANTT_SPACING)
@@ -57,6 +58,200 @@ void GraphScene::addGanttLineSegments(int line, QVector<Measurement> *measuremen
   }
 }
 
+bool GraphScene::readLimits(unsigned sensor, uint64_t *samples) {
+  if(profile->store) {
+    CaptureStore *store = profile->store;
+    if(sensor >= store->sensors()) return false;
+
+    *samples = store->size();
+    minMeasurement = store->header->min[sensor][currentMeasurement];
+    maxMeasurement = store->header->max[sensor][currentMeasurement];
+    minTimeDb = store->header->minTime;
+    maxTimeDb = store->header->maxTime;
+
+    return true;
+  }
+
+  QSqlDatabase db = QSqlDatabase::database("main");
+  QSqlQuery query(db);
+
+  QString sensorString = QString::number(sensor+1);
+
+  query.exec(QString() + "SELECT mintime,maxtime,mincurrent" + sensorString + ",maxcurrent" + sensorString + ",minvoltage" + sensorString + ",maxvoltage" + sensorString + ",minpower" + sensorString + ",maxpower" + sensorString + ",samples FROM meta");
+
+  if(!query.next()) return false;
+
+  *samples = query.value("samples").toDouble();
+
+  switch(currentMeasurement) {
+    case CURRENT: {
+      minMeasurement = query.value("mincurrent" + sensorString).toDouble();
+      maxMeasurement = query.value("maxcurrent" + sensorString).toDouble();
+      break;
+    }
+    case VOLTAGE: {
+      minMeasurement = query.value("minvoltage" + sensorString).toDouble();
+      maxMeasurement = query.value("maxvoltage" + sensorString).toDouble();
+      break;
+    }
+    case POWER: {
+      minMeasurement = query.value("minpower" + sensorString).toDouble();
+      maxMeasurement = query.value("maxpower" + sensorString).toDouble();
+      break;
+    }
+  }
+
+  minTimeDb = query.value("mintime").toLongLong();
+  maxTimeDb = query.value("maxtime").toLongLong();
+
+  return true;
+}
+
+double GraphScene::measurementValue(double current, double voltage) {
+  switch(currentMeasurement) {
+    case CURRENT: return current;
+    case VOLTAGE: return voltage;
+    case POWER:   return current * voltage;
+  }
+  return current;
+}
+
+void GraphScene::readSql(unsigned core, unsigned sensor, uint64_t samplesInWindow, QVector<Measurement> *measurements, QVector<StoreMark> *marks) {
+  QSqlDatabase db = QSqlDatabase::database("main");
+  QSqlQuery query(db);
+
+  QString columns = QString() +
+    "time,timeSinceLast,symbol" + QString::number(core+1) +
+    ",current" + QString::number(sensor+1) +
+    ",voltage" + QString::number(sensor+1);
+
+  // the graph is drawn from the pyramid level with about one bucket per
+  // pixel, each bucket as a line from its min to its max so no peaks are
+  // lost.  Closer than that every sample in the window is drawn
+  unsigned level = PyramidBuilder::level((double)samplesInWindow / scaleFactorTime);
+  bool usePyramid = level >= PYRAMID_MIN_LEVEL;
+
+  if(usePyramid) {
+    QString measurementName;
+    switch(currentMeasurement) {
+      case CURRENT: measurementName = "current"; break;
+      case VOLTAGE: measurementName = "voltage"; break;
+      case POWER:   measurementName = "power"; break;
+    }
+
+    QString bucket = " sensor = " + QString::number(sensor) + " AND level = " + QString::number(level);
+
+    // include the bucket straddling the left edge, found through the index
+    QString queryString = QString() +
+      "SELECT time,endtime,min" + measurementName + ",max" + measurementName +
+      " FROM pyramid" +
+      " WHERE" + bucket +
+      " AND time >= COALESCE((SELECT MAX(time) FROM pyramid WHERE" + bucket + " AND time <= " + QString::number(minTime) + "), " + QString::number(minTime) + ")" +
+      " AND time <= " + QString::number(maxTime) +
+      " AND endtime >= " + QString::number(minTime) +
+      " ORDER BY time";
+
+    query.exec(queryString);
+
+    while(query.next()) {
+      addPoint(query.value(0).toLongLong(), query.value(2).toDouble());
+      addPoint(query.value(1).toLongLong(), query.value(3).toDouble());
+    }
+
+    // the Gantt chart only needs the symbol at each pixel, found with one
+    // probe on the time index per pixel
+    QSqlQuery probe(db);
+    probe.setForwardOnly(true);
+    probe.prepare("SELECT " + columns + " FROM measurements WHERE time >= ? ORDER BY time LIMIT 1");
+
+    double step = (double)(maxTime - minTime) / scaleFactorTime;
+    int64_t lastTime = -1;
+
+    for(unsigned pixel = 0; pixel < scaleFactorTime; pixel++) {
+      probe.bindValue(0, (qint64)(minTime + pixel * step));
+      if(!probe.exec() || !probe.next()) break;
+
+      int64_t time = probe.value(0).toLongLong();
+      if(time > maxTime) break;
+      if(time == lastTime) continue;
+      lastTime = time;
+
+      measurements->push_back(Measurement(time, probe.value(1).toLongLong(),
+                                          measurementValue(probe.value(3).toDouble(), probe.value(4).toDouble()),
+                                          probe.value(2).toUInt()));
+    }
+
+  } else {
+    query.setForwardOnly(true);
+    query.exec("SELECT " + columns + " FROM measurements" +
+               " WHERE time BETWEEN " + QString::number(minTime) + " AND " + QString::number(maxTime));
+
+    while(query.next()) {
+      int64_t time = query.value(0).toLongLong();
+      double measurement = measurementValue(query.value(3).toDouble(), query.value(4).toDouble());
+
+      addPoint(time, measurement);
+
+      measurements->push_back(Measurement(time, query.value(1).toLongLong(), measurement, query.value(2).toUInt()));
+    }
+  }
+
+  QString queryString = QString() +
+    "SELECT time,delay FROM marks" +
+    " WHERE time BETWEEN " + QString::number(minTime) + " AND " + QString::number(maxTime);
+
+  query.exec(queryString);
+
+  while(query.next()) {
+    StoreMark mark;
+    mark.time = query.value("time").toLongLong();
+    mark.delay = query.value("delay").toLongLong();
+    marks->push_back(mark);
+  }
+}
+
+void GraphScene::readStore(unsigned core, unsigned sensor, QVector<Measurement> *measurements, QVector<StoreMark> *marks) {
+  CaptureStore *store = profile->store;
+
+  uint64_t begin = store->lowerBound(minTime);
+  uint64_t end = store->upperBound(maxTime);
+  uint64_t samplesInWindow = end - begin;
+
+  // the columns are scanned in place, drawing min and max of the samples that
+  // fall on each pixel
+  uint64_t perPixel = samplesInWindow / scaleFactorTime;
+  if(perPixel < 2) {
+    for(uint64_t i = begin; i < end; i++) {
+      addPoint(store->time[i], store->value(sensor, currentMeasurement, i));
+    }
+  } else {
+    for(uint64_t i = begin; i < end; i += perPixel) {
+      uint64_t last = i + perPixel < end ? i + perPixel : end;
+      double low = store->value(sensor, currentMeasurement, i);
+      double high = low;
+      for(uint64_t j = i + 1; j < last; j++) {
+        double value = store->value(sensor, currentMeasurement, j);
+        if(value < low) low = value;
+        if(value > high) high = value;
+      }
+      addPoint(store->time[i], low);
+      addPoint(store->time[last - 1], high);
+    }
+  }
+
+  uint64_t stride = perPixel ? perPixel : 1;
+  for(uint64_t i = begin; i < end; i += stride) {
+    unsigned symbol = core < store->cores() ? store->symbol[core][i] : store->symbolNames.size();
+    measurements->push_back(Measurement(store->time[i], store->timeSinceLast(i), store->value(sensor, currentMeasurement, i), symbol));
+  }
+
+  for(uint64_t i = 0; i < store->numMarks(); i++) {
+    if((store->marks[i].time >= minTime) && (store->marks[i].time <= maxTime)) {
+      marks->push_back(store->marks[i]);
+    }
+  }
+}
+
 void GraphScene::drawProfile(unsigned core, unsigned sensor, MeasurementType measurement, Profile *profile, int64_t beginTime, int64_t endTime) {
   clear();
   ganttLines.clear();
@@ -68,133 +263,58 @@ void GraphScene::drawProfile(unsigned core, unsigned sensor, MeasurementType mea
   this->profile = profile;
 
   QVector<Measurement> *measurements = new QVector<Measurement>;
+  QVector<StoreMark> marks;
 
-  if(profile) {
-    QSqlDatabase db = QSqlDatabase::database("main");
-    QSqlQuery query(db);
-
-    QString sensorString = QString::number(sensor+1);
-
-    query.exec(QString() + "SELECT mintime,maxtime,mincurrent" + sensorString + ",maxcurrent" + sensorString + ",minvoltage" + sensorString + ",maxvoltage" + sensorString + ",minpower" + sensorString + ",maxpower" + sensorString + ",samples FROM meta");
-
-    if(query.next()) {
-      uint64_t samples = query.value("samples").toDouble();
+  uint64_t samples;
 
-      switch(currentMeasurement) {
-        case CURRENT: {
-          minMeasurement = query.value("mincurrent" + sensorString).toDouble() + minMeasurementIncrement;
-          maxMeasurement = query.value("maxcurrent" + sensorString).toDouble() + maxMeasurementIncrement;
-          break;
-        }
-        case VOLTAGE: {
-          minMeasurement = query.value("minvoltage" + sensorString).toDouble() + minMeasurementIncrement;
-          maxMeasurement = query.value("maxvoltage" + sensorString).toDouble() + maxMeasurementIncrement;
-          break;
-        }
-        case POWER: {
-          minMeasurement = query.value("minpower" + sensorString).toDouble() + minMeasurementIncrement;
-          maxMeasurement = query.value("maxpower" + sensorString).toDouble() + maxMeasurementIncrement;
-          break;
-        }
-      }
+  if(profile && readLimits(sensor, &samples)) {
+    minMeasurement += minMeasurementIncrement;
+    maxMeasurement += maxMeasurementIncrement;
 
-      minTimeDb = query.value("mintime").toLongLong();
-      maxTimeDb = query.value("maxtime").toLongLong();
+    if(samples > 1) {
+      if(beginTime < minTimeDb) minTime = minTimeDb;
+      else minTime = beginTime;
 
-      if(samples > 1) {
-        if(beginTime < minTimeDb) minTime = minTimeDb;
-        else minTime = beginTime;
+      if(endTime < 0) maxTime = maxTimeDb;
+      else maxTime = endTime;
 
-        if(endTime < 0) maxTime = maxTimeDb;
-        else maxTime = endTime;
+      graph = new Graph(font(), currentMeasurement, 
+                        scaleMeasurement(minMeasurement), scaleMeasurement(maxMeasurement),
+                        scaleTime(minTime), scaleTime(maxTime),
+                        minMeasurement, maxMeasurement, lynsyn_cyclesToSeconds(minTime-minTimeDb), lynsyn_cyclesToSeconds(maxTime-minTimeDb));
+      graph->setPos(0, GRAPH_SIZE-GANTT_SPACING);
+      addItem(graph);
+      graph->setZValue(10);
 
-        graph = new Graph(font(), currentMeasurement, 
-                          scaleMeasurement(minMeasurement), scaleMeasurement(maxMeasurement),
-                          scaleTime(minTime), scaleTime(maxTime),
-                          minMeasurement, maxMeasurement, lynsyn_cyclesToSeconds(minTime-minTimeDb), lynsyn_cyclesToSeconds(maxTime-minTimeDb));
-        graph->setPos(0, GRAPH_SIZE-GANTT_SPACING);
-        addItem(graph);
-        graph->setZValue(10);
+      if(profile->store) {
+        readStore(core, sensor, measurements, &marks);
 
+      } else {
         unsigned ticksPerSample = (maxTimeDb - minTimeDb) / samples;
         int64_t ticks = maxTime - minTime;
         uint64_t samplesInWindow = ticks / ticksPerSample;
-        int stride = samplesInWindow / scaleFactorTime;
-        if(stride < 1) stride = 1;
-
-        QString queryString = QString() +
-          "SELECT time,timeSinceLast,function" + QString::number(core+1) +
-          ",module" + QString::number(core+1) +
-          ",current" + QString::number(sensor+1) +
-          ",voltage" + QString::number(sensor+1) +
-          " FROM measurements" +
-          " WHERE time BETWEEN " + QString::number(minTime) + " AND " + QString::number(maxTime) + 
-          " AND rowid % " + QString::number(stride) + " = 0";
-
-        query.exec(queryString);
-
-        //MovingAverage ma(Config::window);
-
-        if(query.next()) {
-          //bool initialized = false;
-        
-          do {
-            int64_t time = query.value("time").toLongLong();
-            int64_t timeSinceLast = query.value("timeSinceLast").toLongLong();
-
-            double current = query.value("current" + QString::number(sensor+1)).toDouble();
-            double voltage = query.value("voltage" + QString::number(sensor+1)).toDouble();
-            double measurement = current;
-            switch(currentMeasurement) {
-              case CURRENT: measurement = current; break;
-              case VOLTAGE: measurement = voltage; break;
-              case POWER:   measurement = current * voltage; break;
-            }
-
-            QString module = query.value("module" + QString::number(core+1)).toString();
-            QString function = query.value("function" + QString::number(core+1)).toString();
-
-            // if(!initialized) {
-            //   ma.initialize(measurement);
-            //   initialized = true;
-            // }
-
-            // double avg = ma.next(measurement);
-
-            addPoint(time, measurement);
-
-            measurements->push_back(Measurement(time, timeSinceLast, measurement, module, function));
-          
-          } while(query.next());
-        }
-
-        unsigned ganttSize = 0;
-
-        std::vector<ProfLine*> table;
-        profile->buildProfTable(measurements, table);
-        ProfSort profSort;
-        std::sort(table.begin(), table.end(), profSort);
 
-        for(auto profLine : table) {
-          if(profLine->measurements.size() > 0) {
-            int l = addGanttLine(profLine->id, NTNU_BLUE);
-            addGanttLineSegments(l, profLine->getMeasurements());
-            ganttSize = GANTT_SPACING + (l+1) * LINE_SPACING;
-          }
-        }
+        readSql(core, sensor, samplesInWindow, measurements, &marks);
+      }
 
-        queryString = QString() +
-          "SELECT time,delay FROM marks" +
-          " WHERE time BETWEEN " + QString::number(minTime) + " AND " + QString::number(maxTime);
+      unsigned ganttSize = 0;
 
-        query.exec(queryString);
+      std::vector<ProfLine*> table;
+      profile->buildProfTable(measurements, table);
+      ProfSort profSort;
+      std::sort(table.begin(), table.end(), profSort);
 
-        while(query.next()) {
-          int64_t time = query.value("time").toLongLong();
-          int64_t delay = query.value("delay").toLongLong();
-          addMarkLine(time, time + delay, ganttSize, NTNU_YELLOW);
+      for(auto profLine : table) {
+        if(profLine->measurements.size() > 0) {
+          int l = addGanttLine(profLine->id, NTNU_BLUE);
+          addGanttLineSegments(l, profLine->getMeasurements());
+          ganttSize = GANTT_SPACING + (l+1) * LINE_SPACING;
         }
       }
+
+      for(auto mark : marks) {
+        addMarkLine(mark.time, mark.time + mark.delay, ganttSize, NTNU_YELLOW);
+      }
     }
   }
 
@@ -252,6 +372,12 @@ double GraphScene::posToSeconds(double pos) {
   return lynsyn_cyclesToSeconds(posToTime(pos) - minTimeDb);
 }
 
+bool GraphScene::rangeStatistics(int64_t beginTime, int64_t endTime, double *duration, double *energy) {
+  if(!graph) return false;
+  if(beginTime > endTime) std::swap(beginTime, endTime);
+  return profile->rangeStatistics(currentSensor, beginTime, endTime, duration, energy);
+}
+
 double GraphScene::posToMeasurement(double pos) {
   if(!graph) return 0;
   return (graph->getPoint(pos) / scaleFactorMeasurement) * (maxMeasurement-minMeasurement) + minMeasurement;
@@ -103,6 +103,10 @@ private:
   void addPoint(int64_t time, double value);
   void addMarkLine(int64_t timeStart, int64_t timeEnd, unsigned depth, QColor color);
   void buildProfTable(QVector<Measurement> *measurements, std::vector<ProfLine*> &table);
+  bool readLimits(unsigned sensor, uint64_t *samples);
+  double measurementValue(double current, double voltage);
+  void readSql(unsigned core, unsigned sensor, uint64_t samplesInWindow, QVector<Measurement> *measurements, QVector<StoreMark> *marks);
+  void readStore(unsigned core, unsigned sensor, QVector<Measurement> *measurements, QVector<StoreMark> *marks);
 
 public:
   int64_t minTime;
@@ -127,6 +131,7 @@ public:
   int64_t posToTime(double pos);
   double posToSeconds(double pos);
   double posToMeasurement(double pos);
+  bool rangeStatistics(int64_t beginTime, int64_t endTime, double *duration, double *energy);
   void clearScene() {
     profile = NULL;
     clear();
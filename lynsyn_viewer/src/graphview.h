@@ -53,6 +53,21 @@ protected:
     }
   }
 
+  void mouseMoveEvent(QMouseEvent *mouseEvent) {
+    if(mouseEvent->buttons() & Qt::LeftButton) {
+      QPointF pos = mapToScene(mouseEvent->pos());
+      int64_t time = scene->posToTime(pos.x());
+
+      double duration, energy;
+      if(scene->rangeStatistics(beginTime, time, &duration, &energy)) {
+        double power = (duration > 0) ? energy / duration : 0;
+        QString statusMessage = QString::asprintf("Selection: %.6fs Energy: %.6fJ Average power: %.6fW", duration, energy, power);
+        statusBar->showMessage(statusMessage);
+      }
+    }
+    QGraphicsView::mouseMoveEvent(mouseEvent);
+  }
+
   void mouseReleaseEvent(QMouseEvent *mouseEvent) {
     if(mouseEvent->button() == Qt::LeftButton) {
       QPointF pos = mapToScene(mouseEvent->pos());
@@ -46,8 +46,8 @@ ImportDialog::~ImportDialog() {
 }
 
 void ImportDialog::updateCsv() {
-  QFileDialog dialog(this, "Select CSV file to import");
-  dialog.setNameFilter(tr("CSV (*.csv)"));
+  QFileDialog dialog(this, "Select CSV file or capture to import");
+  dialog.setNameFilter(tr("CSV (*.csv);;All files (*)"));
   dialog.setAcceptMode(QFileDialog::AcceptOpen);
   if(dialog.exec()) {
     ui->csvEdit->setText(dialog.selectedFiles()[0]);
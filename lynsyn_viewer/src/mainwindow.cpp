@@ -50,14 +50,98 @@ void MainWindow::updateComboboxes() {
   if(coreBox->count() != 0) coreBox->setCurrentIndex(Config::core);
 }
 
+void MainWindow::updateMarkTable() {
+  QVector<MarkInterval> intervals;
+  profile->markIntervals(Config::sensor, intervals);
+
+  int64_t minTime = intervals.size() ? intervals[0].beginTime : 0;
+
+  markTable->setRowCount(intervals.size());
+  for(int i = 0; i < intervals.size(); i++) {
+    MarkInterval *interval = &intervals[i];
+    double power = (interval->duration > 0) ? interval->energy / interval->duration : 0;
+    markTable->setItem(i, 0, new QTableWidgetItem(QString::number(lynsyn_cyclesToSeconds(interval->beginTime - minTime))));
+    markTable->setItem(i, 1, new QTableWidgetItem(QString::number(interval->duration)));
+    markTable->setItem(i, 2, new QTableWidgetItem(QString::number(power)));
+    markTable->setItem(i, 3, new QTableWidgetItem(QString::number(interval->energy)));
+  }
+}
+
+void MainWindow::updateCaptureTable() {
+  QVector<CatalogEntry> entries = catalog->entries();
+
+  captureTable->setRowCount(entries.size());
+  for(int i = 0; i < entries.size(); i++) {
+    CatalogEntry *entry = &entries[i];
+
+    QTableWidgetItem *nameItem = new QTableWidgetItem(entry->name);
+    nameItem->setData(Qt::UserRole, entry->id);
+    if(entry->id == currentCapture) {
+      QFont font = nameItem->font();
+      font.setBold(true);
+      nameItem->setFont(font);
+    }
+
+    captureTable->setItem(i, 0, nameItem);
+    captureTable->setItem(i, 1, new QTableWidgetItem(entry->date.toString("yyyy-MM-dd hh:mm:ss")));
+    captureTable->setItem(i, 2, new QTableWidgetItem(entry->board));
+    captureTable->setItem(i, 3, new QTableWidgetItem(QString::number(entry->duration)));
+    captureTable->setItem(i, 4, new QTableWidgetItem(QString::number(entry->samples)));
+    captureTable->setItem(i, 5, new QTableWidgetItem(entry->elfFilenames.join(", ")));
+  }
+}
+
+bool MainWindow::selectCapture(int id) {
+  CatalogEntry entry;
+  if(!catalog->entry(id, &entry)) return false;
+
+  if(entry.store) {
+    if(!profile->openCapture(entry.filename, entry.elfFilenames, entry.kallsyms)) return false;
+  } else {
+    profile->open(entry.filename);
+  }
+
+  currentCapture = id;
+  setWindowTitle(QString(APP_NAME) + " - " + entry.name);
+
+  return true;
+}
+
+void MainWindow::closePendingCapture(bool success) {
+  if(success && selectCapture(pendingCapture)) {
+    uint64_t samples;
+    double duration;
+    profile->summary(&samples, &duration);
+    catalog->update(pendingCapture, samples, duration);
+  } else {
+    if(currentCapture == pendingCapture) {
+      profile->open(PROFILE_EMPTY_DB);
+      currentCapture = -1;
+      setWindowTitle(APP_NAME);
+    }
+    catalog->remove(pendingCapture);
+  }
+
+  pendingCapture = -1;
+
+  updateCaptureTable();
+}
+
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWindow) {
   ui->setupUi(this);
 
-  profile = new Profile("lynsyn_profile.db");
+  catalog = new Catalog(CATALOG_FILENAME);
+  catalog->connect();
+
+  profile = new Profile(PROFILE_EMPTY_DB);
   connect(profile, SIGNAL(advance(int, QString)), this, SLOT(advance(int, QString)), Qt::BlockingQueuedConnection);
+  connect(profile, SIGNAL(updated()), this, SLOT(updateLive()));
 
   profile->connect();
 
+  currentCapture = -1;
+  pendingCapture = -1;
+
   progDialog = NULL;
   profDialog = NULL;
 
@@ -84,6 +168,21 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
   tableView->setSortingEnabled(true);
   ui->tabWidget->addTab(tableView, "Profile Table");
 
+  markTable = new QTableWidget();
+  markTable->setColumnCount(4);
+  markTable->setHorizontalHeaderLabels({ "Start [s]", "Duration [s]", "Power [W]", "Energy [J]" });
+  markTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  ui->tabWidget->addTab(markTable, "Mark Intervals");
+
+  captureTable = new QTableWidget();
+  captureTable->setColumnCount(6);
+  captureTable->setHorizontalHeaderLabels({ "Name", "Date", "Board", "Duration [s]", "Samples", "ELF files" });
+  captureTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  captureTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+  captureTable->setSelectionMode(QAbstractItemView::SingleSelection);
+  connect(captureTable, SIGNAL(cellDoubleClicked(int, int)), this, SLOT(changeCapture(int, int)));
+  ui->tabWidget->addTab(captureTable, "Captures");
+
   // statusbar
   statusBar()->showMessage("");
 
@@ -99,6 +198,12 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
   Config::sensor = settings.value("sensor", 0).toUInt();
   Config::measurement = settings.value("measurement", 0).toUInt();
 
+  if(!selectCapture(settings.value("capture", -1).toInt())) {
+    QVector<CatalogEntry> entries = catalog->entries();
+    if(entries.size()) selectCapture(entries[0].id);
+  }
+  updateCaptureTable();
+
   updateComboboxes();
 
   measurementBox->setCurrentIndex(Config::measurement);
@@ -111,6 +216,8 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent), ui(new Ui::MainWi
   tableView->sortByColumn(0, Qt::AscendingOrder);
   tableView->horizontalHeader()->restoreState(settings.value("tableViewState").toByteArray());
 
+  updateMarkTable();
+
   graphScene->drawProfile(Config::core, Config::sensor, (MeasurementType)Config::measurement, profile);
 }
 
@@ -125,6 +232,7 @@ void MainWindow::closeEvent(QCloseEvent *event) {
   settings.setValue("core", Config::core);
   settings.setValue("sensor", Config::sensor);
   settings.setValue("measurement", Config::measurement);
+  settings.setValue("capture", currentCapture);
   if(tableView->model()) {
     settings.setValue("tableViewState", tableView->horizontalHeader()->saveState());
   }
@@ -190,36 +298,168 @@ void MainWindow::showHwInfo() {
 void MainWindow::importCsv() {
   ImportDialog importDialog;
   if(importDialog.exec()) {
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-    if(profile->importCsv(importDialog.ui->csvEdit->text(),
-                          importDialog.ui->elfEdit->text().split(','),
-                          importDialog.ui->kallsymsEdit->text())) {
+    QString filename = importDialog.ui->csvEdit->text();
+    QStringList elfFilenames = importDialog.ui->elfEdit->text().split(',');
+    QString kallsyms = importDialog.ui->kallsymsEdit->text();
+
+    // compressed sampler captures are opened directly, without an import
+    if(CaptureStore::isCapture(filename)) {
+      QApplication::setOverrideCursor(Qt::WaitCursor);
+
+      QString path = QFileInfo(filename).absoluteFilePath();
+      int id = catalog->find(path);
+      bool created = false;
+      if(id == -1) {
+        CatalogEntry entry;
+        if(catalog->create(QFileInfo(filename).fileName(), true, path, "", elfFilenames, kallsyms, &entry)) {
+          id = entry.id;
+          created = true;
+        }
+      }
 
-      graphScene->clearScene();
+      if((id != -1) && selectCapture(id)) {
+        if(created) {
+          uint64_t samples;
+          double duration;
+          profile->summary(&samples, &duration);
+          catalog->update(id, samples, duration);
+        }
 
-      tableView->setModel(NULL);
-      profModel->recalc(Config::core, Config::sensor);
-      tableView->setModel(profModel);
-      QSettings settings;
-      tableView->horizontalHeader()->restoreState(settings.value("tableViewState").toByteArray());
+        updateViews();
+        updateCaptureTable();
 
-      graphScene->drawProfile(Config::core, Config::sensor, (MeasurementType)Config::measurement, profile);
+        QApplication::restoreOverrideCursor();
+        QMessageBox msgBox;
+        msgBox.setText("Import done");
+        msgBox.exec();
+      } else {
+        if(created) catalog->remove(id);
 
-      updateComboboxes();
+        QApplication::restoreOverrideCursor();
+        QMessageBox msgBox;
+        msgBox.setText("Can't import");
+        msgBox.exec();
+      }
+      return;
+    }
 
-      QApplication::restoreOverrideCursor();
-      QMessageBox msgBox;
-      msgBox.setText("Import done");
-      msgBox.exec();
-    } else {
-      QApplication::restoreOverrideCursor();
+    CatalogEntry entry;
+    if(!catalog->create(QFileInfo(filename).fileName(), false, "", "", elfFilenames, kallsyms, &entry)) {
       QMessageBox msgBox;
       msgBox.setText("Can't import");
       msgBox.exec();
+      return;
     }
+    pendingCapture = entry.id;
+
+    profile->setTarget(entry.filename);
+    profile->setImportParameters(filename, elfFilenames, kallsyms);
+
+    progDialog = new QProgressDialog("", "Cancel", 0, IMPORT_PROGRESS_STEPS, this);
+    progDialog->setWindowModality(Qt::WindowModal);
+    progDialog->setMinimumDuration(0);
+    progDialog->setValue(0);
+    connect(progDialog, SIGNAL(canceled()), this, SLOT(cancelRun()));
+
+    thread.wait();
+    profile->moveToThread(&thread);
+    connect(&thread, SIGNAL (started()), profile, SLOT (runImport()));
+    connect(profile, SIGNAL(finished(int, QString)), this, SLOT(finishImport(int, QString)));
+    thread.start();
   }
 }
 
+void MainWindow::cancelRun() {
+  profile->cancel();
+}
+
+void MainWindow::finishImport(int error, QString msg) {
+  delete progDialog;
+  progDialog = NULL;
+
+  disconnect(&thread, SIGNAL (started()), 0, 0);
+  disconnect(profile, SIGNAL(finished(int, QString)), 0, 0);
+
+  thread.quit();
+
+  closePendingCapture(!error);
+
+  if(error) {
+    QMessageBox msgBox;
+    msgBox.setText(msg);
+    msgBox.exec();
+    return;
+  }
+
+  updateViews();
+
+  QMessageBox msgBox;
+  msgBox.setText("Import done");
+  msgBox.exec();
+}
+
+void MainWindow::changeCapture(int row, int column) {
+  Q_UNUSED(column);
+
+  QTableWidgetItem *item = captureTable->item(row, 0);
+  if(!item) return;
+
+  QApplication::setOverrideCursor(Qt::WaitCursor);
+  bool success = selectCapture(item->data(Qt::UserRole).toInt());
+  if(success) {
+    updateViews();
+    updateCaptureTable();
+  }
+  QApplication::restoreOverrideCursor();
+
+  if(!success) {
+    QMessageBox msgBox;
+    msgBox.setText("Can't open capture");
+    msgBox.exec();
+  }
+}
+
+void MainWindow::deleteCapture() {
+  QTableWidgetItem *item = captureTable->item(captureTable->currentRow(), 0);
+  int id = item ? item->data(Qt::UserRole).toInt() : currentCapture;
+
+  CatalogEntry entry;
+  if(!catalog->entry(id, &entry)) return;
+
+  if(QMessageBox::question(this, "Delete capture", "Delete capture \"" + entry.name + "\"?") != QMessageBox::Yes) return;
+
+  if(id == currentCapture) {
+    profile->open(PROFILE_EMPTY_DB);
+    currentCapture = -1;
+    setWindowTitle(APP_NAME);
+  }
+
+  catalog->remove(id);
+
+  if(currentCapture == -1) {
+    QVector<CatalogEntry> entries = catalog->entries();
+    if(entries.size()) selectCapture(entries[0].id);
+    updateViews();
+  }
+
+  updateCaptureTable();
+}
+
+void MainWindow::updateViews() {
+  graphScene->clearScene();
+
+  tableView->setModel(NULL);
+  profModel->recalc(Config::core, Config::sensor);
+  tableView->setModel(profModel);
+  QSettings settings;
+  tableView->horizontalHeader()->restoreState(settings.value("tableViewState").toByteArray());
+
+  graphScene->drawProfile(Config::core, Config::sensor, (MeasurementType)Config::measurement, profile);
+
+  updateComboboxes();
+  updateMarkTable();
+}
+
 void MainWindow::exportCsv() {
   QFileDialog dialog(this, "Select CSV file for export");
   dialog.setNameFilter(tr("CSV (*.csv)"));
@@ -303,13 +543,35 @@ void MainWindow::profileEvent() {
       if(profDialog->result() == QDialog::Accepted) {
         QApplication::setOverrideCursor(Qt::WaitCursor);
 
-        profile->clean();
+        QStringList elfFilenames = profDialog->ui->elfEdit->text().split(',');
+        QString name = elfFilenames[0].simplified().isEmpty() ? "Capture" : QFileInfo(elfFilenames[0]).fileName();
+
+        CatalogEntry entry;
+        if(!catalog->create(name, false, "", lynsyn_getVersionString(hwVersion), elfFilenames, profDialog->ui->kallsymsEdit->text(), &entry)) {
+          profile->endProfiler();
+          delete profDialog;
+          profDialog = NULL;
+          QApplication::restoreOverrideCursor();
+          QMessageBox msgBox;
+          msgBox.setText("Can't create capture");
+          msgBox.exec();
+          return;
+        }
+        pendingCapture = entry.id;
+
+        // show the new capture right away, it is redrawn at every commit
+        selectCapture(pendingCapture);
+        updateViews();
+        updateCaptureTable();
+
+        profile->setTarget(entry.filename);
         profile->setParameters(profDialog);
 
-        progDialog = new QProgressDialog("", QString(), 0, 3, this);
+        progDialog = new QProgressDialog("", "Stop", 0, 3, this);
         progDialog->setWindowModality(Qt::WindowModal);
         progDialog->setMinimumDuration(0);
         progDialog->setValue(0);
+        connect(progDialog, SIGNAL(canceled()), this, SLOT(cancelRun()));
 
         thread.wait();
         profile->moveToThread(&thread);
@@ -344,6 +606,8 @@ void MainWindow::finishProfile(int error, QString msg) {
 
   profile->endProfiler();
 
+  closePendingCapture(!error);
+
   updateComboboxes();
 
   QApplication::restoreOverrideCursor();
@@ -372,9 +636,18 @@ void MainWindow::finishProfile(int error, QString msg) {
   QSettings settings;
   tableView->horizontalHeader()->restoreState(settings.value("tableViewState").toByteArray());
 
+  updateMarkTable();
+
   graphScene->drawProfile(Config::core, Config::sensor, (MeasurementType)Config::measurement, profile);
 }
 
+void MainWindow::updateLive() {
+  if((pendingCapture == -1) || (currentCapture != pendingCapture)) return;
+
+  profile->reload();
+  updateViews();
+}
+
 void MainWindow::changeCore(int core) {
   Config::core = core;
 
@@ -391,6 +664,8 @@ void MainWindow::changeCore(int core) {
 void MainWindow::changeSensor(int sensor) {
   Config::sensor = sensor;
 
+  updateMarkTable();
+
   tableView->setModel(NULL);
   profModel->recalc(Config::core, Config::sensor);
   tableView->setModel(profModel);
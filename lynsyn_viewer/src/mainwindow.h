@@ -28,6 +28,7 @@
 #include "graphscene.h"
 #include "graphview.h"
 #include "profmodel.h"
+#include "catalog.h"
 
 namespace Ui {
   class MainWindow;
@@ -37,6 +38,9 @@ class MainWindow : public QMainWindow {
   Q_OBJECT
 
   Profile *profile;
+  Catalog *catalog;
+  int currentCapture;
+  int pendingCapture;
   GraphScene *graphScene;
   GraphView *graphView;
   QComboBox *measurementBox;
@@ -45,11 +49,18 @@ class MainWindow : public QMainWindow {
   ProfileDialog *profDialog;
   QTableView *tableView;
   ProfModel *profModel;
+  QTableWidget *markTable;
+  QTableWidget *captureTable;
 
   QThread thread;
   QProgressDialog *progDialog;
 
   void updateComboboxes();
+  void updateMarkTable();
+  void updateViews();
+  void updateCaptureTable();
+  bool selectCapture(int id);
+  void closePendingCapture(bool success);
 
 public:
   explicit MainWindow(QWidget *parent = 0);
@@ -59,10 +70,15 @@ private slots:
   void about();
   void showHwInfo();
   void importCsv();
+  void cancelRun();
+  void finishImport(int error, QString msg);
+  void changeCapture(int row, int column);
+  void deleteCapture();
   void exportCsv();
   void upgrade();
   void profileEvent();
   void finishProfile(int error, QString msg);
+  void updateLive();
   void advance(int step, QString msg);
   void changeCore(int core);
   void changeSensor(int sensor);
@@ -36,14 +36,14 @@ public:
 
   double power;
 
-  QString id;
+  unsigned symbol;
 
   static unsigned counter;
 
   Measurement() {}
 
-  Measurement(uint64_t time, uint64_t timeSinceLast, double power, QString module, QString function) {
-    this->id = module + ":" + function;
+  Measurement(uint64_t time, uint64_t timeSinceLast, double power, unsigned symbol) {
+    this->symbol = symbol;
     this->time = time;
     this->timeSinceLast = timeSinceLast;
     this->power = power;
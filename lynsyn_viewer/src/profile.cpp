@@ -24,12 +24,134 @@
 #include "profile.h"
 #include "lynsyn.h"
 #include "elfsupport.h"
+#include "sqlbatch.h"
+#include "symboldictionary.h"
+#include "pyramid.h"
+#include "csvreader.h"
+
+// connections that write a capture trade durability for speed, a lost capture
+// is simply recaptured
+static const char *capturePragmas[] = {
+  "PRAGMA synchronous=OFF",
+  "PRAGMA cache_size=-65536",
+  "PRAGMA temp_store=MEMORY",
+  NULL
+};
+
+static const char *readPragmas[] = {
+  "PRAGMA synchronous=NORMAL",
+  "PRAGMA cache_size=-262144",
+  "PRAGMA temp_store=MEMORY",
+  "PRAGMA mmap_size=1073741824",
+  NULL
+};
+
+static void setPragmas(QSqlDatabase &db, const char **pragmas) {
+  QSqlQuery query(db);
+  for(unsigned i = 0; pragmas[i]; i++) {
+    query.exec(pragmas[i]);
+  }
+}
+
+// a capture leaves a WAL as large as the capture itself, move it into the db
+static void checkpoint(QSqlDatabase &db) {
+  QSqlQuery query(db);
+  query.exec("PRAGMA wal_checkpoint(TRUNCATE)");
+}
+
+CaptureMeta::CaptureMeta(unsigned sensors, unsigned cores) {
+  this->sensors = sensors;
+  this->cores = cores;
+  samples = 0;
+  minTime = -1;
+  maxTime = 0;
+
+  for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
+    minCurrent[i] = 1000000;
+    maxCurrent[i] = 0;
+    minVoltage[i] = 1000000;
+    maxVoltage[i] = 0;
+    minPower[i] = 1000000;
+    maxPower[i] = 0;
+  }
+}
+
+void CaptureMeta::add(int64_t time, double *current, double *voltage) {
+  samples++;
+  if(minTime == -1) minTime = time;
+  maxTime = time;
+  for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
+    if(minCurrent[i] > current[i]) minCurrent[i] = current[i];
+    if(maxCurrent[i] < current[i]) maxCurrent[i] = current[i];
+    if(minVoltage[i] > voltage[i]) minVoltage[i] = voltage[i];
+    if(maxVoltage[i] < voltage[i]) maxVoltage[i] = voltage[i];
+    double power = voltage[i] * current[i];
+    if(minPower[i] > power) minPower[i] = power;
+    if(maxPower[i] < power) maxPower[i] = power;
+  }
+}
+
+bool CaptureMeta::write(QSqlDatabase &db) {
+  QSqlQuery query(db);
+
+  // one row, replaced every time the capture is committed
+  query.exec("DELETE FROM meta");
+
+  QString queryString = "INSERT INTO meta (sensors, cores, samples, mintime, maxtime";
+  for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
+    queryString += ", mincurrent" + QString::number(sensor + 1);
+    queryString += ", maxcurrent" + QString::number(sensor + 1);
+    queryString += ", minvoltage" + QString::number(sensor + 1);
+    queryString += ", maxvoltage" + QString::number(sensor + 1);
+    queryString += ", minpower" + QString::number(sensor + 1);
+    queryString += ", maxpower" + QString::number(sensor + 1);
+  }
+  queryString += ") VALUES (:sensors, :cores, :samples, :mintime, :maxtime";
+  for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
+    queryString += ", :mincurrent" + QString::number(sensor + 1);
+    queryString += ", :maxcurrent" + QString::number(sensor + 1);
+    queryString += ", :minvoltage" + QString::number(sensor + 1);
+    queryString += ", :maxvoltage" + QString::number(sensor + 1);
+    queryString += ", :minpower" + QString::number(sensor + 1);
+    queryString += ", :maxpower" + QString::number(sensor + 1);
+  }
+  queryString += ")";
+
+  query.prepare(queryString);
+
+  query.bindValue(":sensors", sensors);
+  query.bindValue(":cores", cores);
+  query.bindValue(":samples", (qint64)samples);
+  query.bindValue(":mintime", (qint64)minTime);
+  query.bindValue(":maxtime", (qint64)maxTime);
+  for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
+    query.bindValue(":mincurrent" + QString::number(sensor + 1), minCurrent[sensor]);
+    query.bindValue(":maxcurrent" + QString::number(sensor + 1), maxCurrent[sensor]);
+    query.bindValue(":minvoltage" + QString::number(sensor + 1), minVoltage[sensor]);
+    query.bindValue(":maxvoltage" + QString::number(sensor + 1), maxVoltage[sensor]);
+    query.bindValue(":minpower" + QString::number(sensor + 1), minPower[sensor]);
+    query.bindValue(":maxpower" + QString::number(sensor + 1), maxPower[sensor]);
+  }
+
+  bool success = query.exec();
+  if(!success) {
+    printf("SQL Error: %s\n", query.lastError().text().toUtf8().constData());
+    return false;
+  }
+
+  return true;
+}
+
+///////////////////////////////////////////////////////////////////////////////
 
 Profile::Profile(QString dbFilename) {
   this->dbFilename = dbFilename;
+  store = NULL;
+  cancelled = false;
 }
 
 Profile::~Profile() {
+  closeCapture();
   disconnect();
 }
 
@@ -45,26 +167,106 @@ void Profile::connect() {
     assert(0);
   }
 
+  createTables(db);
+  setPragmas(db, readPragmas);
+
+  reload();
+}
+
+void Profile::reload() {
+  QSqlDatabase db = QSqlDatabase::database("main");
   QSqlQuery query(db);
 
-  QString queryString = "CREATE TABLE IF NOT EXISTS measurements (time INT, timeSinceLast INT";
+  query.exec("SELECT sensors,cores FROM meta");
+  if(query.next()) {
+    numSensors = query.value("sensors").toUInt();
+    numCores = query.value("cores").toUInt();
+  } else {
+    numSensors = 0;
+    numCores = 0;
+  }
+
+  loadSymbols();
+}
+
+void Profile::open(QString dbFilename) {
+  closeCapture();
+  disconnect();
+
+  this->dbFilename = dbFilename;
+
+  connect();
+}
+
+void Profile::setTarget(QString targetFilename) {
+  this->targetFilename = targetFilename;
+}
+
+void Profile::createTables(QSqlDatabase &db) {
+  QSqlQuery query(db);
+
+  // WAL lets the capture thread write while the GUI connection reads
+  query.exec("PRAGMA journal_mode=WAL");
+
+  // tables of an older schema can't be read, so they are dropped
+  query.exec("PRAGMA user_version");
+  if(!query.next() || (query.value(0).toUInt() < PROFILE_SCHEMA_VERSION)) {
+    query.exec("DROP TABLE IF EXISTS measurements");
+    query.exec("DROP TABLE IF EXISTS marks");
+    query.exec("DROP TABLE IF EXISTS meta");
+    query.exec("DROP TABLE IF EXISTS symbols");
+    query.exec("DROP TABLE IF EXISTS pyramid");
+    query.exec("DROP TABLE IF EXISTS aggregates");
+    query.exec("PRAGMA user_version=" + QString::number(PROFILE_SCHEMA_VERSION));
+  }
+
+  // cumtime and cumenergy are running sums over all earlier samples, so any
+  // time range can be summed from its two end rows
+  QString queryString = "CREATE TABLE IF NOT EXISTS measurements (time INT, timeSinceLast INT, cumtime INT";
   for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
     queryString += ", pc" + QString::number(core + 1) + " INT";
-    queryString += ", function" + QString::number(core + 1) + " TEXT";
-    queryString += ", module" + QString::number(core + 1) + " TEXT";
+    queryString += ", symbol" + QString::number(core + 1) + " INT";
   }
   for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
     queryString += ", current" + QString::number(sensor + 1) + " REAL";
     queryString += ", voltage" + QString::number(sensor + 1) + " REAL";
+    queryString += ", cumenergy" + QString::number(sensor + 1) + " REAL";
   }
   queryString += ")";
 
-  success = query.exec(queryString);
+  bool success = query.exec(queryString);
+  Q_UNUSED(success);
+  assert(success);
+
+  success = query.exec("CREATE INDEX IF NOT EXISTS measurements_time ON measurements (time)");
   assert(success);
 
   success = query.exec("CREATE TABLE IF NOT EXISTS marks (time INT, delay INT)");
   assert(success);
 
+  success = query.exec("CREATE TABLE IF NOT EXISTS symbols (id INTEGER PRIMARY KEY, function TEXT, module TEXT)");
+  assert(success);
+
+  queryString = "CREATE TABLE IF NOT EXISTS pyramid (sensor INT, level INT, time INT, endtime INT, samples INT";
+  for(QString measurement : { "current", "voltage", "power" }) {
+    queryString += ", min" + measurement + " REAL";
+    queryString += ", max" + measurement + " REAL";
+    queryString += ", mean" + measurement + " REAL";
+  }
+  queryString += ", energy REAL)";
+
+  success = query.exec(queryString);
+  assert(success);
+
+  success = query.exec("CREATE INDEX IF NOT EXISTS pyramid_time ON pyramid (sensor, level, time)");
+  assert(success);
+
+  success = query.exec("CREATE TABLE IF NOT EXISTS aggregates (core INT, sensor INT, symbol INT, samples INT, runtime REAL, power REAL, energy REAL)");
+  assert(success);
+
+  success = query.exec("CREATE INDEX IF NOT EXISTS aggregates_line ON aggregates (core, sensor)");
+  assert(success);
+
   queryString = "CREATE TABLE IF NOT EXISTS meta (sensors INT, cores INT, samples INT, mintime INT, maxtime INT";
   for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
     queryString += ", mincurrent" + QString::number(sensor + 1) + " REAL";
@@ -78,14 +280,103 @@ void Profile::connect() {
 
   success = query.exec(queryString);
   assert(success);
+}
 
-  success = query.exec(QString() + "SELECT sensors,cores FROM meta");
-  if(query.next()) {
-    numSensors = query.value("sensors").toUInt();
-    numCores = query.value("cores").toUInt();
+void Profile::loadSymbols() {
+  QSqlDatabase db = QSqlDatabase::database("main");
+  QSqlQuery query(db);
+
+  symbolNames.clear();
+
+  query.exec("SELECT id,function,module FROM symbols");
+  while(query.next()) {
+    unsigned id = query.value(0).toUInt();
+    if(id >= (unsigned)symbolNames.size()) symbolNames.resize(id + 1);
+    symbolNames[id] = query.value(2).toString() + ":" + query.value(1).toString();
+  }
+}
+
+QString Profile::symbolName(unsigned id) {
+  if(store) {
+    if(id < (unsigned)store->symbolNames.size()) return store->symbolNames[id];
   } else {
-    numSensors = 0;
-    numCores = 0;
+    if(id < (unsigned)symbolNames.size()) return symbolNames[id];
+  }
+  return "Unknown:Unknown";
+}
+
+bool Profile::openCapture(QString captureFilename, QStringList elfFilenames, QString kallsyms) {
+  // the columnar file is kept next to the capture and reused until the
+  // capture changes
+  QString storeFilename = captureFilename + STORE_SUFFIX;
+
+  QFileInfo captureInfo(captureFilename);
+  QFileInfo storeInfo(storeFilename);
+
+  CaptureStore *newStore = new CaptureStore();
+
+  // a cached store that fails to open is stale or damaged and is rebuilt
+  bool upToDate = storeInfo.exists() && (storeInfo.lastModified() >= captureInfo.lastModified());
+
+  if(!upToDate || !newStore->open(storeFilename)) {
+    ElfSupport elfSupport;
+    for(auto elf : elfFilenames) {
+      elfSupport.addElf(elf);
+    }
+    if(!kallsyms.simplified().isEmpty()) elfSupport.addKallsyms(kallsyms);
+
+    if(!CaptureStore::convert(captureFilename, storeFilename, elfSupport) || !newStore->open(storeFilename)) {
+      delete newStore;
+      return false;
+    }
+  }
+
+  closeCapture();
+
+  store = newStore;
+  numSensors = store->sensors();
+  numCores = store->cores();
+
+  return true;
+}
+
+void Profile::closeCapture() {
+  if(store) {
+    delete store;
+    store = NULL;
+
+    QSqlDatabase db = QSqlDatabase::database("main");
+    QSqlQuery query(db);
+    query.exec("SELECT sensors,cores FROM meta");
+    if(query.next()) {
+      numSensors = query.value("sensors").toUInt();
+      numCores = query.value("cores").toUInt();
+    } else {
+      numSensors = 0;
+      numCores = 0;
+    }
+  }
+}
+
+void Profile::summary(uint64_t *samples, double *duration) {
+  *samples = 0;
+  *duration = 0;
+
+  if(store) {
+    if(store->size()) {
+      *samples = store->size();
+      *duration = lynsyn_cyclesToSeconds(store->header->maxTime - store->header->minTime);
+    }
+    return;
+  }
+
+  QSqlDatabase db = QSqlDatabase::database("main");
+  QSqlQuery query(db);
+
+  query.exec("SELECT samples,mintime,maxtime FROM meta");
+  if(query.next()) {
+    *samples = query.value(0).toULongLong();
+    *duration = lynsyn_cyclesToSeconds(query.value(2).toLongLong() - query.value(1).toLongLong());
   }
 }
 
@@ -98,6 +389,9 @@ void Profile::disconnect() {
 }
 
 bool Profile::exportCsv(QString csvFilename) {
+  // captures are converted to CSV with lynsyn_sampler
+  if(store) return false;
+
   QFile csvFile(csvFilename);
   bool success = csvFile.open(QIODevice::WriteOnly);
   if(!success) return false;
@@ -185,197 +479,309 @@ bool Profile::exportCsv(QString csvFilename) {
   return true;
 }
 
-bool Profile::importCsv(QString csvFilename, QStringList elfFilenames, QString kallsyms) {
-  QFile file(csvFilename);
-  if(!file.open(QIODevice::ReadOnly)) return false;
+void Profile::setImportParameters(QString csvFilename, QStringList elfFilenames, QString kallsyms) {
+  this->csvFilename = csvFilename;
+  this->elfFilenames = elfFilenames;
+  this->kallsyms = kallsyms;
+  cancelled = false;
+}
 
-  ElfSupport elfSupport;
-  for(auto elf : elfFilenames) {
-    elfSupport.addElf(elf);
+void Profile::cancel() {
+  cancelled = true;
+}
+
+bool Profile::runImport() {
+  QString msg;
+  bool success = importCsv(&msg);
+
+  // the capture connection must be gone before the GUI thread opens or
+  // deletes the capture
+  QSqlDatabase::removeDatabase("thread");
+
+  emit finished(success ? 0 : 1, msg);
+
+  return success;
+}
+
+bool Profile::importCsv(QString *msg) {
+  emit advance(0, "Reading " + QFileInfo(csvFilename).fileName());
+
+  // workers parse chunks of the file in parallel, this thread is the only
+  // writer and gets the parsed rows back in file order
+  CsvReader reader;
+  if(!reader.open(csvFilename)) {
+    *msg = "Can't import";
+    return false;
   }
-  elfSupport.addKallsyms(kallsyms);
+  unsigned sensors = reader.sensors();
+  unsigned cores = reader.cores();
 
-  clean();
+  QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "thread");
+  db.setDatabaseName(targetFilename);
+  bool success = db.open();
+  Q_UNUSED(success);
+  assert(success);
 
-  QSqlDatabase db = QSqlDatabase::database("main");
-  db.transaction();
+  createTables(db);
+  setPragmas(db, capturePragmas);
 
-  QSqlQuery query(db);
+  db.transaction();
 
-  QString queryString = "INSERT INTO measurements (time, timeSinceLast";
+  QStringList columns = { "time", "timeSinceLast", "cumtime" };
   for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
-    queryString += ", pc" + QString::number(core + 1);
-    queryString += ", function" + QString::number(core + 1);
-    queryString += ", module" + QString::number(core + 1);
+    columns << "pc" + QString::number(core + 1);
   }
   for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
-    queryString += ", current" + QString::number(sensor + 1);
-    queryString += ", voltage" + QString::number(sensor + 1);
+    columns << "current" + QString::number(sensor + 1);
+    columns << "voltage" + QString::number(sensor + 1);
+    columns << "cumenergy" + QString::number(sensor + 1);
   }
-  queryString += ") VALUES (:time, :timeSinceLast";
-  for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
-    queryString += ", :pc" + QString::number(core + 1);
-    queryString += ", :function" + QString::number(core + 1);
-    queryString += ", :module" + QString::number(core + 1);
+
+  SqlBatch insert(db, "measurements", columns);
+  PyramidBuilder pyramid(db, sensors);
+
+  CaptureMeta meta(sensors, cores);
+
+  int64_t lastTime = -1;
+  int64_t cumTime = 0;
+  double cumEnergy[LYNSYN_MAX_SENSORS] = { 0 };
+
+  reader.start();
+
+  std::vector<CsvRow> rows;
+  int progress = 0;
+  bool error = false;
+
+  while(!cancelled && reader.next(rows, &error)) {
+    if(error) break;
+
+    for(auto &row : rows) {
+      int64_t time = row.time;
+      int64_t timeSinceLast = (lastTime == -1) ? 0 : time - lastTime;
+
+      lastTime = time;
+      meta.add(time, row.current, row.voltage);
+
+      cumTime += timeSinceLast;
+
+      insert.add((qint64)time);
+      insert.add((qint64)timeSinceLast);
+      insert.add((qint64)cumTime);
+
+      for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
+        insert.add((qint64)row.pc[core] >> 2);
+      }
+
+      for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
+        cumEnergy[sensor] += row.current[sensor] * row.voltage[sensor] * lynsyn_cyclesToSeconds(timeSinceLast);
+        insert.add(row.current[sensor]);
+        insert.add(row.voltage[sensor]);
+        insert.add(cumEnergy[sensor]);
+      }
+
+      if(!insert.endRow()) {
+        printf("SQL Error: %s\n", insert.lastError().text().toUtf8().constData());
+        error = true;
+        break;
+      }
+
+      if(!pyramid.add(time, timeSinceLast, row.current, row.voltage)) {
+        printf("SQL Error: %s\n", pyramid.lastError().text().toUtf8().constData());
+        error = true;
+        break;
+      }
+    }
+    if(error) break;
+
+    int newProgress = (IMPORT_PROGRESS_READ * reader.position()) / reader.size();
+    if(newProgress != progress) {
+      progress = newProgress;
+      emit advance(progress, "Importing samples");
+    }
   }
-  for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
-    queryString += ", :current" + QString::number(sensor + 1);
-    queryString += ", :voltage" + QString::number(sensor + 1);
+
+  reader.stop();
+
+  if(cancelled || error) {
+    db.rollback();
+    *msg = cancelled ? "Import cancelled" : "Can't import";
+    return false;
   }
-  queryString += ")";
 
-  query.prepare(queryString);
+  if(!insert.flush()) {
+    printf("SQL Error: %s\n", insert.lastError().text().toUtf8().constData());
+    db.rollback();
+    *msg = "Can't import";
+    return false;
+  }
+
+  if(!pyramid.finish()) {
+    printf("SQL Error: %s\n", pyramid.lastError().text().toUtf8().constData());
+    db.rollback();
+    *msg = "Can't import";
+    return false;
+  }
 
-  { // header
-    file.readLine(); // get rid of comment
-    QString line = file.readLine();
-    QStringList tokens = line.split(';');
-    numSensors = tokens[0].toUInt();
-    numCores = tokens[1].toUInt();
-    file.readLine(); // get rid of comment
-  }
-
-  // body
-  int samples = 0;
-  int64_t minTime = -1;
-  int64_t maxTime = 0;
-  double mincurrent[LYNSYN_MAX_SENSORS];
-  double maxcurrent[LYNSYN_MAX_SENSORS];
-  double minvoltage[LYNSYN_MAX_SENSORS];
-  double maxvoltage[LYNSYN_MAX_SENSORS];
-  double minpower[LYNSYN_MAX_SENSORS];
-  double maxpower[LYNSYN_MAX_SENSORS];
+  emit advance(IMPORT_PROGRESS_READ, "Processing samples");
 
-  for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
-    mincurrent[i] = 1000000;
-    maxcurrent[i] = 0;
-    minvoltage[i] = 1000000;
-    maxvoltage[i] = 0;
-    minpower[i] = 1000000;
-    maxpower[i] = 0;
+  ElfSupport elfSupport;
+  for(auto elf : elfFilenames) {
+    if(!elf.simplified().isEmpty()) elfSupport.addElf(elf);
   }
+  if(!kallsyms.simplified().isEmpty()) elfSupport.addKallsyms(kallsyms);
 
-  int64_t lastTime = -1;
+  AggregateTotals totals;
 
-  while(!file.atEnd()) {
-    QString line = file.readLine();
-    QStringList tokens = line.split(';');
+  if(!symbolize(db, elfSupport) || !aggregate(db, sensors, totals) || !meta.write(db)) {
+    db.rollback();
+    *msg = "Can't import";
+    return false;
+  }
 
-    int64_t time = lynsyn_secondsToCycles(tokens[0].toDouble());
-    int64_t timeSinceLast = (lastTime == -1) ? 0 : time - lastTime;
-    uint64_t pc[LYNSYN_MAX_CORES];
-    for(int i = 0; i < LYNSYN_MAX_CORES; i++) {
-      pc[i] = tokens[1+i].toULongLong();
-    }
-    double current[LYNSYN_MAX_SENSORS];
-    for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
-      current[i] = tokens[1 + LYNSYN_MAX_CORES + i].toDouble();
-    }
-    double voltage[LYNSYN_MAX_SENSORS];
-    for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
-      voltage[i] = tokens[1 + LYNSYN_MAX_CORES + LYNSYN_MAX_SENSORS + i].toDouble();
-    }
+  db.commit();
 
-    lastTime = time;
-    samples++;
-    if(minTime == -1) minTime = time;
-    maxTime = time;
-    for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
-      if(mincurrent[i] > current[i]) mincurrent[i] = current[i];
-      if(maxcurrent[i] < current[i]) maxcurrent[i] = current[i];
-      if(minvoltage[i] > voltage[i]) minvoltage[i] = voltage[i];
-      if(maxvoltage[i] < voltage[i]) maxvoltage[i] = voltage[i];
-      double power = voltage[i] * current[i];
-      if(minpower[i] > power) minpower[i] = power;
-      if(maxpower[i] < power) maxpower[i] = power;
-    }
+  checkpoint(db);
 
-    query.bindValue(":time", (qint64)time);
+  return true;
+}
 
-    query.bindValue(":timeSinceLast", (qint64)timeSinceLast);
+bool Profile::symbolize(QSqlDatabase &db, ElfSupport &elfSupport, int64_t fromRow) {
+  // resolve every distinct PC once, then map all rows in a single UPDATE.
+  // Only rows after fromRow are symbolized, so a capture can be done in parts
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
 
-    for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
-      query.bindValue(":pc" + QString::number(core + 1), (qint64)pc[core] >> 2);
-      query.bindValue(":function" + QString::number(core + 1), elfSupport.getFunction(pc[core]));
-      query.bindValue(":module" + QString::number(core + 1), elfSupport.getFilename(pc[core]));
-    }
+  query.exec("DROP TABLE IF EXISTS temp.pcsymbols");
+  query.exec("CREATE TEMP TABLE pcsymbols (pc INTEGER PRIMARY KEY, symbol INT)");
 
-    for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
-      query.bindValue(":current" + QString::number(sensor + 1), current[sensor]);
-      query.bindValue(":voltage" + QString::number(sensor + 1), voltage[sensor]);
-    }
+  QString rows = " WHERE rowid > " + QString::number(fromRow);
 
-    bool success = query.exec();
-    if(!success) {
-      printf("SQL Error: %s\n", query.lastError().text().toUtf8().constData());
+  QString queryString = "SELECT pc1 FROM measurements" + rows;
+  for(int core = 1; core < LYNSYN_MAX_CORES; core++) {
+    queryString += " UNION SELECT pc" + QString::number(core + 1) + " FROM measurements" + rows;
+  }
+
+  bool success = query.exec(queryString);
+  if(!success) {
+    printf("SQL Error: %s\n", query.lastError().text().toUtf8().constData());
+    return false;
+  }
+
+  SymbolDictionary symbols(db);
+  SqlBatch insert(db, "pcsymbols", { "pc", "symbol" });
+
+  while(query.next()) {
+    qint64 pc = query.value(0).toLongLong();
+    QFileInfo info(elfSupport.getFilename(pc << 2));
+
+    insert.add(pc);
+    insert.add(symbols.id(elfSupport.getFunction(pc << 2), info.fileName()));
+
+    if(!insert.endRow()) {
+      printf("SQL Error: %s\n", insert.lastError().text().toUtf8().constData());
       return false;
     }
   }
 
-  {
-    QSqlQuery query(db);
+  if(!insert.flush()) {
+    printf("SQL Error: %s\n", insert.lastError().text().toUtf8().constData());
+    return false;
+  }
 
-    QString queryString = "INSERT INTO meta (sensors, cores, samples, mintime, maxtime";
-    for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
-      queryString += ", mincurrent" + QString::number(sensor + 1);
-      queryString += ", maxcurrent" + QString::number(sensor + 1);
-      queryString += ", minvoltage" + QString::number(sensor + 1);
-      queryString += ", maxvoltage" + QString::number(sensor + 1);
-      queryString += ", minpower" + QString::number(sensor + 1);
-      queryString += ", maxpower" + QString::number(sensor + 1);
-    }
-    queryString += ") VALUES (:sensors, :cores, :samples, :mintime, :maxtime";
-    for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
-      queryString += ", :mincurrent" + QString::number(sensor + 1);
-      queryString += ", :maxcurrent" + QString::number(sensor + 1);
-      queryString += ", :minvoltage" + QString::number(sensor + 1);
-      queryString += ", :maxvoltage" + QString::number(sensor + 1);
-      queryString += ", :minpower" + QString::number(sensor + 1);
-      queryString += ", :maxpower" + QString::number(sensor + 1);
-    }
-    queryString += ")";
+  queryString = "UPDATE measurements SET symbol1=(SELECT symbol FROM pcsymbols WHERE pc=pc1)";
+  for(int core = 1; core < LYNSYN_MAX_CORES; core++) {
+    queryString += ", symbol" + QString::number(core + 1) + "=(SELECT symbol FROM pcsymbols WHERE pc=pc" + QString::number(core + 1) + ")";
+  }
+  queryString += rows;
+
+  success = query.exec(queryString);
+  if(!success) {
+    printf("SQL Error: %s\n", query.lastError().text().toUtf8().constData());
+    return false;
+  }
 
-    query.prepare(queryString);
+  query.exec("DROP TABLE temp.pcsymbols");
 
-    query.bindValue(":sensors", numSensors);
-    query.bindValue(":cores", numCores);
-    query.bindValue(":samples", samples);
-    query.bindValue(":mintime", (qint64)minTime);
-    query.bindValue(":maxtime", (qint64)maxTime);
-    for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
-      query.bindValue(":mincurrent" + QString::number(sensor + 1), mincurrent[sensor]);
-      query.bindValue(":maxcurrent" + QString::number(sensor + 1), maxcurrent[sensor]);
-      query.bindValue(":minvoltage" + QString::number(sensor + 1), minvoltage[sensor]);
-      query.bindValue(":maxvoltage" + QString::number(sensor + 1), maxvoltage[sensor]);
-      query.bindValue(":minpower" + QString::number(sensor + 1), minpower[sensor]);
-      query.bindValue(":maxpower" + QString::number(sensor + 1), maxpower[sensor]);
+  return true;
+}
+
+bool Profile::aggregate(QSqlDatabase &db, unsigned sensors, AggregateTotals &totals, int64_t fromRow) {
+  // one pass per core over the rows after fromRow is added to the totals,
+  // which give runtime, mean power and energy of every symbol for all sensors
+  QSqlQuery query(db);
+  query.setForwardOnly(true);
+
+  for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
+    QString symbolColumn = "symbol" + QString::number(core + 1);
+
+    QString queryString = "SELECT " + symbolColumn + ", COUNT(*), SUM(timeSinceLast)";
+    for(unsigned sensor = 0; sensor < sensors; sensor++) {
+      QString power = "current" + QString::number(sensor + 1) + "*voltage" + QString::number(sensor + 1);
+      queryString += ", SUM(" + power + "), SUM(" + power + "*timeSinceLast)";
     }
+    queryString += " FROM measurements WHERE rowid > " + QString::number(fromRow) + " GROUP BY " + symbolColumn;
 
-    bool success = query.exec();
+    bool success = query.exec(queryString);
     if(!success) {
       printf("SQL Error: %s\n", query.lastError().text().toUtf8().constData());
       return false;
     }
+
+    while(query.next()) {
+      SymbolTotals *line = &totals[qMakePair(core, query.value(0).toUInt())];
+      line->samples += query.value(1).toLongLong();
+      line->time += query.value(2).toDouble();
+
+      for(unsigned sensor = 0; sensor < sensors; sensor++) {
+        line->power[sensor] += query.value(3 + sensor * 2).toDouble();
+        line->energy[sensor] += query.value(4 + sensor * 2).toDouble();
+      }
+    }
   }
 
-  db.commit();
+  // the table is small, so it is simply rewritten
+  query.exec("DELETE FROM aggregates");
+
+  SqlBatch insert(db, "aggregates", { "core", "sensor", "symbol", "samples", "runtime", "power", "energy" });
+
+  for(auto it = totals.constBegin(); it != totals.constEnd(); it++) {
+    const SymbolTotals *line = &it.value();
+
+    for(unsigned sensor = 0; sensor < sensors; sensor++) {
+      insert.add(it.key().first);
+      insert.add(sensor);
+      insert.add(it.key().second);
+      insert.add((qint64)line->samples);
+      insert.add(lynsyn_cyclesToSeconds(line->time));
+      insert.add(line->power[sensor] / line->samples);
+      insert.add(lynsyn_cyclesToSeconds(line->energy[sensor]));
+
+      if(!insert.endRow()) {
+        printf("SQL Error: %s\n", insert.lastError().text().toUtf8().constData());
+        return false;
+      }
+    }
+  }
+
+  if(!insert.flush()) {
+    printf("SQL Error: %s\n", insert.lastError().text().toUtf8().constData());
+    return false;
+  }
 
   return true;
 }
 
-void Profile::clean() {
-  QSqlDatabase db = QSqlDatabase::database("main");
-  clean(db);
-}
+bool Profile::runProfiler() {
+  bool success = captureSamples();
 
-void Profile::clean(QSqlDatabase &db) {
-  QSqlQuery query = QSqlQuery(db);
-  query.exec("DELETE FROM measurements");
-  query.exec("DELETE FROM marks");
-  query.exec("DELETE FROM meta");
+  QSqlDatabase::removeDatabase("thread");
+
+  emit finished(success ? 0 : 1, "");
+
+  return success;
 }
 
-bool Profile::runProfiler() {
+bool Profile::captureSamples() {
   emit advance(0, "Waiting");
 
   double period = profDialog->ui->periodSpinBox->value();
@@ -386,8 +792,15 @@ bool Profile::runProfiler() {
   uint64_t endAddr = 0;
   uint64_t markAddr = 0;
 
-  numSensors = lynsyn_numSensors();
-  numCores = 0;
+  // the capture side counts stay local, the members belong to the GUI thread
+  unsigned captureSensors = lynsyn_numSensors();
+  unsigned captureCores = 0;
+
+  ElfSupport elfSupport;
+  for(auto elf : profDialog->ui->elfEdit->text().split(",")) {
+    if(!elf.simplified().isEmpty()) elfSupport.addElf(elf);
+  }
+  if(!profDialog->ui->kallsymsEdit->text().simplified().isEmpty()) elfSupport.addKallsyms(profDialog->ui->kallsymsEdit->text());
 
   if(profDialog->useJtag) {
     useBp = profDialog->ui->bpCheckBox->checkState() == Qt::Checked;
@@ -395,16 +808,10 @@ bool Profile::runProfiler() {
     for(unsigned i = 0; i < cores(); i++) {
       if(profDialog->coreCheckboxes[i]->checkState() == Qt::Checked) {
         coreMask |= 1 << i;
-        numCores++;
+        captureCores++;
       }
     }
 
-    ElfSupport elfSupport;
-    for(auto elf : profDialog->ui->elfEdit->text().split(',')) {
-      elfSupport.addElf(elf);
-    }
-    elfSupport.addKallsyms(profDialog->ui->kallsymsEdit->text());
-
     QString startBp = profDialog->ui->startEdit->text();
     QString stopBp = profDialog->ui->stopEdit->text();
     QString markBp = profDialog->ui->markEdit->text();
@@ -427,63 +834,50 @@ bool Profile::runProfiler() {
 
   //-----------------------------------------------------------------------------
 
-  int samples = 0;
-  int64_t minTime = -1;
-  int64_t maxTime = 0;
-  double mincurrent[LYNSYN_MAX_SENSORS];
-  double maxcurrent[LYNSYN_MAX_SENSORS];
-  double minvoltage[LYNSYN_MAX_SENSORS];
-  double maxvoltage[LYNSYN_MAX_SENSORS];
-  double minpower[LYNSYN_MAX_SENSORS];
-  double maxpower[LYNSYN_MAX_SENSORS];
+  CaptureMeta meta(captureSensors, captureCores);
+  AggregateTotals totals;
 
   int64_t lastTime = -1;
-
-  for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
-    mincurrent[i] = 1000000;
-    maxcurrent[i] = 0;
-    minvoltage[i] = 1000000;
-    maxvoltage[i] = 0;
-    minpower[i] = 1000000;
-    maxpower[i] = 0;
-  }
+  int64_t cumTime = 0;
+  double cumEnergy[LYNSYN_MAX_SENSORS] = { 0 };
 
   QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "thread");
-  db.setDatabaseName(dbFilename);
+  db.setDatabaseName(targetFilename);
   bool success = db.open();
   Q_UNUSED(success);
   assert(success);
 
-  clean(db);
+  createTables(db);
+  setPragmas(db, capturePragmas);
 
   db.transaction();
 
-  QSqlQuery query(db);
-
-  QString queryString = "INSERT INTO measurements (time, timeSinceLast";
+  QStringList columns = { "time", "timeSinceLast", "cumtime" };
   for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
-    queryString += ", pc" + QString::number(core + 1);
+    columns << "pc" + QString::number(core + 1);
   }
   for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
-    queryString += ", current" + QString::number(sensor + 1);
-    queryString += ", voltage" + QString::number(sensor + 1);
+    columns << "current" + QString::number(sensor + 1);
+    columns << "voltage" + QString::number(sensor + 1);
+    columns << "cumenergy" + QString::number(sensor + 1);
   }
-  queryString += ") VALUES (:time, :timeSinceLast";
-  for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
-    queryString += ", :pc" + QString::number(core + 1);
-  }
-  for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
-    queryString += ", :current" + QString::number(sensor + 1);
-    queryString += ", :voltage" + QString::number(sensor + 1);
-  }
-  queryString += ")";
 
-  query.prepare(queryString);
+  SqlBatch insert(db, "measurements", columns);
+  PyramidBuilder pyramid(db, captureSensors);
+
+  QSqlQuery markQuery(db);
+  markQuery.prepare("INSERT INTO marks (time, delay) VALUES (?, ?)");
+
+  // the capture is committed in parts, each part symbolized and aggregated,
+  // so the GUI connection can follow a long capture while it runs
+  QElapsedTimer commitTimer;
+  commitTimer.start();
+  int64_t committedRows = 0;
 
   bool started = false;
 
   struct LynsynSample sample;
-  while(lynsyn_getNextSample(&sample)) {
+  while(!cancelled && lynsyn_getNextSample(&sample)) {
 
     if(!started) {
       emit advance(1, "Collecting samples");
@@ -497,12 +891,8 @@ bool Profile::runProfiler() {
     }
 
     if(sample.flags & SAMPLE_REPLY_FLAG_MARK) {
-      QSqlQuery markQuery(db);
-
-      markQuery.prepare("INSERT INTO marks (time, delay) VALUES (:time, :delay)");
-
-      markQuery.bindValue(":time", (qint64)sample.time);
-      markQuery.bindValue(":delay", (qint64)sample.pc[0] - (qint64)sample.time);
+      markQuery.bindValue(0, (qint64)sample.time);
+      markQuery.bindValue(1, (qint64)sample.pc[0] - (qint64)sample.time);
 
       bool success = markQuery.exec();
       Q_UNUSED(success);
@@ -516,155 +906,87 @@ bool Profile::runProfiler() {
         timeSinceLast = sample.time - lastTime;
       }
       lastTime = sample.time;
-      samples++;
-      if(minTime == -1) minTime = sample.time;
-      maxTime = sample.time;
-      for(int i = 0; i < LYNSYN_MAX_SENSORS; i++) {
-        if(mincurrent[i] > sample.current[i]) mincurrent[i] = sample.current[i];
-        if(maxcurrent[i] < sample.current[i]) maxcurrent[i] = sample.current[i];
-        if(minvoltage[i] > sample.voltage[i]) minvoltage[i] = sample.voltage[i];
-        if(maxvoltage[i] < sample.voltage[i]) maxvoltage[i] = sample.voltage[i];
-        double power = sample.voltage[i] * sample.current[i];
-        if(minpower[i] > power) minpower[i] = power;
-        if(maxpower[i] < power) maxpower[i] = power;
-      }
+      meta.add(sample.time, sample.current, sample.voltage);
 
-      query.bindValue(":time", (qint64)sample.time);
+      cumTime += timeSinceLast;
 
-      query.bindValue(":timeSinceLast", (qint64)timeSinceLast);
+      insert.add((qint64)sample.time);
+      insert.add((qint64)timeSinceLast);
+      insert.add((qint64)cumTime);
 
       for(unsigned core = 0; core < LYNSYN_MAX_CORES; core++) {
-        query.bindValue(":pc" + QString::number(core + 1), (qint64)sample.pc[core] >> 2);
+        insert.add((qint64)sample.pc[core] >> 2);
       }
 
       for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
-        query.bindValue(":current" + QString::number(sensor + 1), sample.current[sensor]);
-        query.bindValue(":voltage" + QString::number(sensor + 1), sample.voltage[sensor]);
+        cumEnergy[sensor] += sample.current[sensor] * sample.voltage[sensor] * lynsyn_cyclesToSeconds(timeSinceLast);
+        insert.add(sample.current[sensor]);
+        insert.add(sample.voltage[sensor]);
+        insert.add(cumEnergy[sensor]);
       }
 
-      bool success = query.exec();
-      if(!success) {
-        printf("SQL Error: %s\n", query.lastError().text().toUtf8().constData());
+      if(!insert.endRow()) {
+        printf("SQL Error: %s\n", insert.lastError().text().toUtf8().constData());
         exit(1);
       }
-    }
-  }
-
-  {
-    QSqlQuery query(db);
-
-    QString queryString = "INSERT INTO meta (sensors, cores, samples, mintime, maxtime";
-    for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
-      queryString += ", mincurrent" + QString::number(sensor + 1);
-      queryString += ", maxcurrent" + QString::number(sensor + 1);
-      queryString += ", minvoltage" + QString::number(sensor + 1);
-      queryString += ", maxvoltage" + QString::number(sensor + 1);
-      queryString += ", minpower" + QString::number(sensor + 1);
-      queryString += ", maxpower" + QString::number(sensor + 1);
-    }
-    queryString += ") VALUES (:sensors, :cores, :samples, :mintime, :maxtime";
-    for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
-      queryString += ", :mincurrent" + QString::number(sensor + 1);
-      queryString += ", :maxcurrent" + QString::number(sensor + 1);
-      queryString += ", :minvoltage" + QString::number(sensor + 1);
-      queryString += ", :maxvoltage" + QString::number(sensor + 1);
-      queryString += ", :minpower" + QString::number(sensor + 1);
-      queryString += ", :maxpower" + QString::number(sensor + 1);
-    }
-    queryString += ")";
-
-    query.prepare(queryString);
 
-    query.bindValue(":sensors", numSensors);
-    query.bindValue(":cores", numCores);
-    query.bindValue(":samples", samples);
-    query.bindValue(":mintime", (qint64)minTime);
-    query.bindValue(":maxtime", (qint64)maxTime);
-    for(unsigned sensor = 0; sensor < LYNSYN_MAX_SENSORS; sensor++) {
-      query.bindValue(":mincurrent" + QString::number(sensor + 1), mincurrent[sensor]);
-      query.bindValue(":maxcurrent" + QString::number(sensor + 1), maxcurrent[sensor]);
-      query.bindValue(":minvoltage" + QString::number(sensor + 1), minvoltage[sensor]);
-      query.bindValue(":maxvoltage" + QString::number(sensor + 1), maxvoltage[sensor]);
-      query.bindValue(":minpower" + QString::number(sensor + 1), minpower[sensor]);
-      query.bindValue(":maxpower" + QString::number(sensor + 1), maxpower[sensor]);
+      if(!pyramid.add(sample.time, timeSinceLast, sample.current, sample.voltage)) {
+        printf("SQL Error: %s\n", pyramid.lastError().text().toUtf8().constData());
+        exit(1);
+      }
     }
 
-    bool success = query.exec();
-    if(!success) {
-      printf("SQL Error: %s\n", query.lastError().text().toUtf8().constData());
-      exit(1);
-    }
-  }
+    if(commitTimer.hasExpired(CAPTURE_COMMIT_INTERVAL)) {
+      if(!insert.flush()) {
+        printf("SQL Error: %s\n", insert.lastError().text().toUtf8().constData());
+        exit(1);
+      }
 
-  db.commit();
+      if(!pyramid.flush()) {
+        printf("SQL Error: %s\n", pyramid.lastError().text().toUtf8().constData());
+        exit(1);
+      }
 
-  {
-    emit advance(2, "Processing samples");
+      if(!symbolize(db, elfSupport, committedRows)) exit(1);
+      if(!aggregate(db, captureSensors, totals, committedRows)) exit(1);
+      if(!meta.write(db)) exit(1);
 
-    ElfSupport elfSupport;
-    for(auto elf : profDialog->ui->elfEdit->text().split(",")) {
-      if(!elf.simplified().isEmpty()) elfSupport.addElf(elf);
-    }
-    if(!profDialog->ui->kallsymsEdit->text().simplified().isEmpty()) elfSupport.addKallsyms(profDialog->ui->kallsymsEdit->text());
+      db.commit();
+      committedRows = meta.samples;
 
-    QSqlQuery query(db);
-    query.setForwardOnly(true);
-    
-    QString queryString = "SELECT rowid";
-    for(int core = 0; core < LYNSYN_MAX_CORES; core++) {
-      queryString += ", pc" + QString::number(core + 1);
-    }
-    queryString += " FROM measurements";
+      emit updated();
 
-    bool success = query.exec(queryString);
-    if(!success) {
-      printf("SQL Error: %s\n", query.lastError().text().toUtf8().constData());
-      exit(1);
+      db.transaction();
+      commitTimer.restart();
     }
+  }
 
-    db.transaction();
+  if(!insert.flush()) {
+    printf("SQL Error: %s\n", insert.lastError().text().toUtf8().constData());
+    exit(1);
+  }
 
-    queryString = "UPDATE measurements SET function1=:function1, module1=:module1";
-    for(int core = 1; core < LYNSYN_MAX_CORES; core++) {
-      queryString += ", function" + QString::number(core + 1) + "=:function" + QString::number(core + 1); 
-      queryString += ", module" + QString::number(core + 1) + "=:module" + QString::number(core + 1); 
-    }
-    queryString += " WHERE rowid=:rowid";
+  if(!pyramid.finish()) {
+    printf("SQL Error: %s\n", pyramid.lastError().text().toUtf8().constData());
+    exit(1);
+  }
 
-    QSqlQuery updateQuery(db);
-    updateQuery.prepare(queryString);
-    
-    while(query.next()) {
-      unsigned rowId = query.value("rowid").toUInt();
-      uint64_t pc[LYNSYN_MAX_CORES];
-      for(int core = 0; core < LYNSYN_MAX_CORES; core++) {
-        pc[core] = query.value("pc" + QString::number(core + 1)).toULongLong() << 2;
-      }
+  emit advance(2, "Processing samples");
 
-      updateQuery.bindValue(":rowid", rowId);
-      for(int core = 0; core < LYNSYN_MAX_CORES; core++) {
-        updateQuery.bindValue(":function" + QString::number(core + 1), elfSupport.getFunction(pc[core]));
-        QFileInfo info(elfSupport.getFilename(pc[core]));
-        updateQuery.bindValue(":module" + QString::number(core + 1), info.fileName());
-      }
+  if(!symbolize(db, elfSupport, committedRows)) exit(1);
+  if(!aggregate(db, captureSensors, totals, committedRows)) exit(1);
+  if(!meta.write(db)) exit(1);
 
-      bool success = updateQuery.exec();
-      if(!success) {
-        printf("SQL Error: %s\n", query.lastError().text().toUtf8().constData());
-        exit(1);
-      }
-    }
-
-    db.commit();
-  }
+  db.commit();
 
-  emit finished(0, "");
+  checkpoint(db);
 
   return true;
 }
 
 void Profile::setParameters(ProfileDialog *profDialog) {
   this->profDialog = profDialog;
+  cancelled = false;
 }
 
 bool Profile::initProfiler(bool *useJtag) {
@@ -690,15 +1012,15 @@ unsigned Profile::sensors() {
 }
 
 void Profile::buildProfTable(QVector<Measurement> *measurements, std::vector<ProfLine*> &table) {
-  QMap<QString,ProfLine*> lineMap;
+  QHash<unsigned,ProfLine*> lineMap;
   for(auto m : *measurements) {
-    auto it = lineMap.find(m.id);
+    auto it = lineMap.find(m.symbol);
     ProfLine *profLine = NULL;
     if(it != lineMap.end()) {
       profLine = *it;
     } else {
-      profLine = new ProfLine(m.id);
-      lineMap[m.id] = profLine;
+      profLine = new ProfLine(symbolName(m.symbol));
+      lineMap[m.symbol] = profLine;
     }
     profLine->addMeasurement(m);
   }
@@ -708,36 +1030,122 @@ void Profile::buildProfTable(QVector<Measurement> *measurements, std::vector<Pro
 }
 
 void Profile::buildProfTable(unsigned core, unsigned sensor, std::vector<ProfLine*> &table) {
+  if(store) {
+    if(sensor >= store->sensors()) return;
+
+    // the aggregates are built when the store is converted, cores missing
+    // from the capture share the last one
+    unsigned storeCore = core < store->cores() ? core : store->cores();
+
+    for(uint64_t i = 0; i < store->numAggregates(); i++) {
+      const struct StoreAggregate *aggregate = &store->aggregates[i];
+      if((aggregate->core == storeCore) && aggregate->samples) {
+        table.push_back(new ProfLine(symbolName(aggregate->symbol), aggregate->samples, aggregate->runtime,
+                                     aggregate->power[sensor], aggregate->energy[sensor]));
+      }
+    }
+
+    return;
+  }
+
   QSqlDatabase db = QSqlDatabase::database("main");
   QSqlQuery query(db);
 
-  QVector<Measurement> *measurements = new QVector<Measurement>;
-
   QString queryString = QString() +
-    "SELECT time,timeSinceLast,function" + QString::number(core+1) +
-    ",module" + QString::number(core+1) +
-    ",current" + QString::number(sensor+1) +
-    ",voltage" + QString::number(sensor+1) +
-    " FROM measurements";
+    "SELECT symbol,samples,runtime,power,energy FROM aggregates" +
+    " WHERE core = " + QString::number(core) + " AND sensor = " + QString::number(sensor);
 
   query.exec(queryString);
 
   while(query.next()) {
-    int64_t time = query.value("time").toLongLong();
-    int64_t timeSinceLast = query.value("timeSinceLast").toLongLong();
+    unsigned symbol = query.value(0).toUInt();
+    unsigned samples = query.value(1).toUInt();
+    double runtime = query.value(2).toDouble();
+    double power = query.value(3).toDouble();
+    double energy = query.value(4).toDouble();
+
+    table.push_back(new ProfLine(symbolName(symbol), samples, runtime, power, energy));
+  }
+}
+
+bool Profile::rangeStatistics(unsigned sensor, int64_t beginTime, int64_t endTime, double *duration, double *energy) {
+  if(store) return store->rangeStatistics(sensor, beginTime, endTime, duration, energy);
+
+  QSqlDatabase db = QSqlDatabase::database("main");
+  QSqlQuery query(db);
+
+  QString columns = "SELECT cumtime,cumenergy" + QString::number(sensor + 1) + " FROM measurements";
 
-    double current = query.value("current" + QString::number(sensor+1)).toDouble();
-    double voltage = query.value("voltage" + QString::number(sensor+1)).toDouble();
+  query.exec(columns + " WHERE time >= " + QString::number(beginTime) + " ORDER BY time LIMIT 1");
+  if(!query.next()) return false;
+  int64_t beginCumTime = query.value(0).toLongLong();
+  double beginCumEnergy = query.value(1).toDouble();
 
-    double power = current * voltage;
+  query.exec(columns + " WHERE time <= " + QString::number(endTime) + " ORDER BY time DESC LIMIT 1");
+  if(!query.next()) return false;
+  int64_t endCumTime = query.value(0).toLongLong();
+  double endCumEnergy = query.value(1).toDouble();
 
-    QString module = query.value("module" + QString::number(core+1)).toString();
-    QString function = query.value("function" + QString::number(core+1)).toString();
+  if(endCumTime < beginCumTime) return false;
+
+  *duration = lynsyn_cyclesToSeconds(endCumTime - beginCumTime);
+  *energy = endCumEnergy - beginCumEnergy;
+
+  return true;
+}
+
+void Profile::markIntervals(unsigned sensor, QVector<MarkInterval> &intervals) {
+  int64_t minTime;
+  int64_t maxTime;
+  QVector<StoreMark> marks;
+
+  if(store) {
+    if(!store->size()) return;
+    minTime = store->header->minTime;
+    maxTime = store->header->maxTime;
+    for(uint64_t i = 0; i < store->numMarks(); i++) {
+      marks.push_back(store->marks[i]);
+    }
 
-    measurements->push_back(Measurement(time, timeSinceLast, power, module, function));
+  } else {
+    QSqlDatabase db = QSqlDatabase::database("main");
+    QSqlQuery query(db);
+
+    query.exec("SELECT mintime,maxtime FROM meta");
+    if(!query.next()) return;
+    minTime = query.value(0).toLongLong();
+    maxTime = query.value(1).toLongLong();
+
+    query.exec("SELECT time,delay FROM marks ORDER BY time");
+    while(query.next()) {
+      StoreMark mark;
+      mark.time = query.value(0).toLongLong();
+      mark.delay = query.value(1).toLongLong();
+      marks.push_back(mark);
+    }
   }
 
-  buildProfTable(measurements, table);
+  // intervals run from where sampling resumed after a mark to the next mark
+  int64_t beginTime = minTime;
+
+  QVector<int64_t> beginTimes;
+  QVector<int64_t> endTimes;
+  for(auto mark : marks) {
+    beginTimes.push_back(beginTime);
+    endTimes.push_back(mark.time);
+    beginTime = mark.time + mark.delay;
+  }
+  beginTimes.push_back(beginTime);
+  endTimes.push_back(maxTime);
+
+  for(int i = 0; i < beginTimes.size(); i++) {
+    MarkInterval interval;
+    interval.beginTime = beginTimes[i];
+    interval.endTime = endTimes[i];
+    if(rangeStatistics(sensor, interval.beginTime, interval.endTime, &interval.duration, &interval.energy)) {
+      intervals.push_back(interval);
+    }
+  }
 }
 
 LynsynSample Profile::getSample() {
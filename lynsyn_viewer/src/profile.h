@@ -22,33 +22,120 @@
 #ifndef PROFILE_H
 #define PROFILE_H
 
+#include <atomic>
+
 #include <QString>
 #include <QFile>
 #include <QtSql>
 
 #include "profiledialog.h"
 #include "profline.h"
+#include "elfsupport.h"
+#include "capturestore.h"
+
+// bump when the tables change, older databases are dropped on connect
+#define PROFILE_SCHEMA_VERSION 4
+
+// database used when no capture is selected
+#define PROFILE_EMPTY_DB ":memory:"
+
+// progress steps of an import, reading the samples takes the first part
+#define IMPORT_PROGRESS_STEPS 100
+#define IMPORT_PROGRESS_READ 90
+
+// longest time in ms between commits while capturing
+#define CAPTURE_COMMIT_INTERVAL 1000
+
+class MarkInterval {
+public:
+  int64_t beginTime;
+  int64_t endTime;
+  double duration;
+  double energy;
+};
+
+// sample count, time span and value ranges, stored in the meta table
+class CaptureMeta {
+public:
+  unsigned sensors;
+  unsigned cores;
+  int64_t samples;
+  int64_t minTime;
+  int64_t maxTime;
+  double minCurrent[LYNSYN_MAX_SENSORS];
+  double maxCurrent[LYNSYN_MAX_SENSORS];
+  double minVoltage[LYNSYN_MAX_SENSORS];
+  double maxVoltage[LYNSYN_MAX_SENSORS];
+  double minPower[LYNSYN_MAX_SENSORS];
+  double maxPower[LYNSYN_MAX_SENSORS];
+
+  CaptureMeta(unsigned sensors, unsigned cores);
+
+  void add(int64_t time, double *current, double *voltage);
+  bool write(QSqlDatabase &db);
+};
+
+// running sums of the samples of one symbol on one core, time in cycles
+class SymbolTotals {
+public:
+  int64_t samples;
+  double time;
+  double power[LYNSYN_MAX_SENSORS];
+  double energy[LYNSYN_MAX_SENSORS];
+
+  SymbolTotals() {
+    samples = 0;
+    time = 0;
+    for(unsigned i = 0; i < LYNSYN_MAX_SENSORS; i++) {
+      power[i] = 0;
+      energy[i] = 0;
+    }
+  }
+};
+
+// keyed by core and symbol
+typedef QMap<QPair<unsigned, unsigned>, SymbolTotals> AggregateTotals;
 
 class Profile : public QObject {
   Q_OBJECT
 
 private:
   QString dbFilename;
+  QString targetFilename;
   ProfileDialog *profDialog;
+  QVector<QString> symbolNames;
+  QString csvFilename;
+  QStringList elfFilenames;
+  QString kallsyms;
+  std::atomic<bool> cancelled;
+
+  bool symbolize(QSqlDatabase &db, ElfSupport &elfSupport, int64_t fromRow = 0);
+  bool aggregate(QSqlDatabase &db, unsigned sensors, AggregateTotals &totals, int64_t fromRow = 0);
+  static void createTables(QSqlDatabase &db);
+  bool importCsv(QString *msg);
+  bool captureSamples();
 
 public:
   unsigned numSensors;
   unsigned numCores;
+  CaptureStore *store;
 
   Profile(QString dbFilename);
   ~Profile();
   void connect();
   void disconnect();
+  void open(QString dbFilename);
+  void setTarget(QString targetFilename);
+  void summary(uint64_t *samples, double *duration);
+  void loadSymbols();
+  void reload();
+  QString symbolName(unsigned id);
 
-  bool importCsv(QString csvFilename, QStringList elfFilenames, QString kallsyms);
+  void setImportParameters(QString csvFilename, QStringList elfFilenames, QString kallsyms);
+  void cancel();
+  bool openCapture(QString captureFilename, QStringList elfFilenames, QString kallsyms);
+  void closeCapture();
   bool exportCsv(QString csvFilename);
-  void clean();
-  void clean(QSqlDatabase &db);
 
   bool initProfiler(bool *useJtag);
   bool endProfiler();
@@ -58,13 +145,17 @@ public:
   void buildProfTable(unsigned core, unsigned sensor, std::vector<ProfLine*> &table);  
   void buildProfTable(QVector<Measurement> *measurements, std::vector<ProfLine*> &table);
   LynsynSample getSample();
+  bool rangeStatistics(unsigned sensor, int64_t beginTime, int64_t endTime, double *duration, double *energy);
+  void markIntervals(unsigned sensor, QVector<MarkInterval> &intervals);
 
 public slots:
   bool runProfiler();
+  bool runImport();
     
 signals:
   void advance(int step, QString msg);
   void finished(int ret, QString msg);
+  void updated();
 };
 
 #endif
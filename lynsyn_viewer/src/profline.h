@@ -50,6 +50,15 @@ public:
     this->measurementCount = 0;
   }
 
+  ProfLine(QString id, unsigned count, double runtime, double power, double energy) {
+    this->id = id;
+
+    this->runtime = runtime;
+    this->power = power * count;
+    this->energy = energy;
+    this->measurementCount = count;
+  }
+
   void addMeasurement(Measurement m) {
     double secondsSinceLast = lynsyn_cyclesToSeconds(m.timeSinceLast);
 
@@ -69,6 +78,7 @@ public:
     return power / measurementCount;
   }
   double getEnergy() { return energy; }
+  unsigned getCount() { return measurementCount; }
   double getRuntime() { return runtime; }
 
 };
@@ -51,7 +51,7 @@ public:
   }
   bool operator() (ProfLine *i, ProfLine *j) {
     if(column == -1) {
-      return i->measurements.size() > j->measurements.size();
+      return i->getCount() > j->getCount();
     }
 
     if(order == Qt::AscendingOrder) {
@@ -0,0 +1,162 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "pyramid.h"
+
+static const char *measurementNames[PYRAMID_MEASUREMENTS] = { "current", "voltage", "power" };
+
+void PyramidBucket::add(int64_t time, double current, double voltage, double seconds) {
+  double value[PYRAMID_MEASUREMENTS];
+  value[CURRENT] = current;
+  value[VOLTAGE] = voltage;
+  value[POWER] = current * voltage;
+
+  if(!count) {
+    this->time = time;
+    for(unsigned i = 0; i < PYRAMID_MEASUREMENTS; i++) {
+      min[i] = value[i];
+      max[i] = value[i];
+      sum[i] = 0;
+    }
+  }
+
+  for(unsigned i = 0; i < PYRAMID_MEASUREMENTS; i++) {
+    if(value[i] < min[i]) min[i] = value[i];
+    if(value[i] > max[i]) max[i] = value[i];
+    sum[i] += value[i];
+  }
+  energy += value[POWER] * seconds;
+
+  endTime = time;
+  count++;
+}
+
+void PyramidBucket::merge(const PyramidBucket &other) {
+  if(!other.count) return;
+
+  if(!count) {
+    *this = other;
+    return;
+  }
+
+  for(unsigned i = 0; i < PYRAMID_MEASUREMENTS; i++) {
+    if(other.min[i] < min[i]) min[i] = other.min[i];
+    if(other.max[i] > max[i]) max[i] = other.max[i];
+    sum[i] += other.sum[i];
+  }
+  energy += other.energy;
+
+  endTime = other.endTime;
+  count += other.count;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+
+PyramidBuilder::PyramidBuilder(QSqlDatabase &db, unsigned sensors) : insert(db, "pyramid", columns()) {
+  this->sensors = sensors;
+  samples = 0;
+}
+
+QStringList PyramidBuilder::columns() {
+  QStringList columns = { "sensor", "level", "time", "endtime", "samples" };
+  for(unsigned i = 0; i < PYRAMID_MEASUREMENTS; i++) {
+    columns << QString("min") + measurementNames[i];
+    columns << QString("max") + measurementNames[i];
+    columns << QString("mean") + measurementNames[i];
+  }
+  columns << "energy";
+  return columns;
+}
+
+unsigned PyramidBuilder::level(double samplesPerPixel) {
+  unsigned level = 0;
+  while((level < PYRAMID_MAX_LEVEL) && ((double)(1ull << (level + 1)) <= samplesPerPixel)) level++;
+  return level;
+}
+
+bool PyramidBuilder::write(unsigned level) {
+  for(unsigned sensor = 0; sensor < sensors; sensor++) {
+    PyramidBucket *bucket = &buckets[level][sensor];
+
+    insert.add(sensor);
+    insert.add(level + PYRAMID_MIN_LEVEL);
+    insert.add((qint64)bucket->time);
+    insert.add((qint64)bucket->endTime);
+    insert.add((qint64)bucket->count);
+    for(unsigned i = 0; i < PYRAMID_MEASUREMENTS; i++) {
+      insert.add(bucket->min[i]);
+      insert.add(bucket->max[i]);
+      insert.add(bucket->sum[i] / bucket->count);
+    }
+    insert.add(bucket->energy);
+
+    if(!insert.endRow()) return false;
+  }
+
+  return true;
+}
+
+bool PyramidBuilder::add(int64_t time, int64_t timeSinceLast, double *current, double *voltage) {
+  if(!sensors) return true;
+
+  double seconds = lynsyn_cyclesToSeconds(timeSinceLast);
+
+  for(unsigned sensor = 0; sensor < sensors; sensor++) {
+    buckets[0][sensor].add(time, current[sensor], voltage[sensor], seconds);
+  }
+  samples++;
+
+  // full buckets are written and carried upwards like a binary counter
+  for(unsigned level = 0; level < PYRAMID_LEVELS - 1; level++) {
+    if(buckets[level][0].count < (1ull << (level + PYRAMID_MIN_LEVEL))) break;
+
+    if(!write(level)) return false;
+
+    for(unsigned sensor = 0; sensor < sensors; sensor++) {
+      buckets[level + 1][sensor].merge(buckets[level][sensor]);
+      buckets[level][sensor].clear();
+    }
+  }
+
+  return true;
+}
+
+bool PyramidBuilder::finish() {
+  if(!sensors) return true;
+
+  // write the partial buckets, each one is part of the bucket above it
+  for(unsigned level = 0; level < PYRAMID_LEVELS; level++) {
+    if(!buckets[level][0].count) continue;
+
+    if(!write(level)) return false;
+
+    if(buckets[level][0].count == samples) break;
+
+    if(level < PYRAMID_LEVELS - 1) {
+      for(unsigned sensor = 0; sensor < sensors; sensor++) {
+        buckets[level + 1][sensor].merge(buckets[level][sensor]);
+        buckets[level][sensor].clear();
+      }
+    }
+  }
+
+  return insert.flush();
+}
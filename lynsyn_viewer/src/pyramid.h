@@ -0,0 +1,88 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#include <QtSql>
+
+#include "lynsyn.h"
+#include "lynsyn_viewer.h"
+#include "sqlbatch.h"
+
+// buckets at level n hold 2^n samples, lower levels are read from measurements
+#define PYRAMID_MIN_LEVEL 4
+#define PYRAMID_MAX_LEVEL 40
+#define PYRAMID_LEVELS (PYRAMID_MAX_LEVEL - PYRAMID_MIN_LEVEL + 1)
+
+// indexed by MeasurementType
+#define PYRAMID_MEASUREMENTS 3
+
+class PyramidBucket {
+public:
+  int64_t time;
+  int64_t endTime;
+  uint64_t count;
+  double min[PYRAMID_MEASUREMENTS];
+  double max[PYRAMID_MEASUREMENTS];
+  double sum[PYRAMID_MEASUREMENTS];
+  double energy;
+
+  PyramidBucket() {
+    clear();
+  }
+
+  void clear() {
+    count = 0;
+    energy = 0;
+  }
+
+  void add(int64_t time, double current, double voltage, double seconds);
+  void merge(const PyramidBucket &other);
+};
+
+/**
+ * Builds a level of detail pyramid of the measurements while they are
+ * ingested.  Each level stores min, max, mean and energy for every sensor
+ * in buckets of a power of two samples, so the graph can draw any zoom level
+ * from about one bucket per pixel without losing peaks.
+ */
+class PyramidBuilder {
+  unsigned sensors;
+  uint64_t samples;
+  PyramidBucket buckets[PYRAMID_LEVELS][LYNSYN_MAX_SENSORS];
+  SqlBatch insert;
+
+  bool write(unsigned level);
+
+public:
+  PyramidBuilder(QSqlDatabase &db, unsigned sensors);
+
+  bool add(int64_t time, int64_t timeSinceLast, double *current, double *voltage);
+  bool finish();
+  bool flush() { return insert.flush(); } // writes the full buckets only
+  QSqlError lastError() { return insert.lastError(); }
+
+  static unsigned level(double samplesPerPixel);
+  static QStringList columns();
+};
+
+#endif
@@ -0,0 +1,73 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "sqlbatch.h"
+
+SqlBatch::SqlBatch(QSqlDatabase &db, QString table, QStringList columns) : batchQuery(db), restQuery(db) {
+  this->table = table;
+  this->columns = columns;
+
+  batchRows = SQLITE_MAX_VARIABLES / columns.size();
+  if(batchRows < 1) batchRows = 1;
+  restRows = 0;
+
+  batchQuery.prepare(statement(batchRows));
+
+  values.resize(batchRows * columns.size());
+  pos = 0;
+}
+
+QString SqlBatch::statement(unsigned rows) {
+  QString row = "(?" + QString(", ?").repeated(columns.size() - 1) + ")";
+
+  QString queryString = "INSERT INTO " + table + " (" + columns.join(", ") + ") VALUES " + row;
+  for(unsigned i = 1; i < rows; i++) {
+    queryString += ", " + row;
+  }
+
+  return queryString;
+}
+
+bool SqlBatch::exec(QSqlQuery &query, unsigned rows) {
+  int count = rows * columns.size();
+  for(int i = 0; i < count; i++) {
+    query.bindValue(i, values[i]);
+  }
+  pos = 0;
+
+  bool success = query.exec();
+  if(!success) error = query.lastError();
+  return success;
+}
+
+bool SqlBatch::flush() {
+  if(!pos) return true;
+
+  unsigned rows = pos / columns.size();
+
+  // the statement for a partial batch is kept for the next flush of the same size
+  if(rows != restRows) {
+    restQuery.prepare(statement(rows));
+    restRows = rows;
+  }
+
+  return exec(restQuery, rows);
+}
@@ -0,0 +1,67 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef SQLBATCH_H
+#define SQLBATCH_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QVariant>
+#include <QtSql>
+
+// lowest SQLITE_MAX_VARIABLE_NUMBER of the SQLite versions we build against
+#define SQLITE_MAX_VARIABLES 999
+
+/**
+ * Inserts rows into a table with multi-row INSERT statements.  Values are
+ * added positionally into a preallocated buffer, and a full batch is written
+ * with one prepared statement execution.
+ */
+class SqlBatch {
+  QString table;
+  QStringList columns;
+  unsigned batchRows;
+  QSqlQuery batchQuery;
+  QSqlQuery restQuery;
+  unsigned restRows;
+  QVector<QVariant> values;
+  int pos;
+  QSqlError error;
+
+  QString statement(unsigned rows);
+  bool exec(QSqlQuery &query, unsigned rows);
+
+public:
+  SqlBatch(QSqlDatabase &db, QString table, QStringList columns);
+
+  void add(const QVariant &value) {
+    values[pos++] = value;
+  }
+  bool endRow() {
+    if(pos < values.size()) return true;
+    return exec(batchQuery, batchRows);
+  }
+  bool flush();
+  QSqlError lastError() { return error; }
+};
+
+#endif
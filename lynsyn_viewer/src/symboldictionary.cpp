@@ -0,0 +1,57 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <stdio.h>
+
+#include "symboldictionary.h"
+
+SymbolDictionary::SymbolDictionary(QSqlDatabase &db) : insertQuery(db) {
+  nextId = 0;
+
+  QSqlQuery query(db);
+  query.exec("SELECT id,function,module FROM symbols");
+  while(query.next()) {
+    unsigned id = query.value(0).toUInt();
+    ids[query.value(2).toString() + ":" + query.value(1).toString()] = id;
+    if(id >= nextId) nextId = id + 1;
+  }
+
+  insertQuery.prepare("INSERT INTO symbols (id, function, module) VALUES (?, ?, ?)");
+}
+
+unsigned SymbolDictionary::id(QString function, QString module) {
+  QString key = module + ":" + function;
+
+  auto it = ids.constFind(key);
+  if(it != ids.constEnd()) return *it;
+
+  unsigned id = nextId++;
+  ids[key] = id;
+
+  insertQuery.bindValue(0, id);
+  insertQuery.bindValue(1, function);
+  insertQuery.bindValue(2, module);
+  if(!insertQuery.exec()) {
+    printf("SQL Error: %s\n", insertQuery.lastError().text().toUtf8().constData());
+  }
+
+  return id;
+}
@@ -0,0 +1,45 @@
+/******************************************************************************
+ *
+ *  This file is part of the Lynsyn host tools
+ *
+ *  Copyright 2019 Asbjørn Djupdal, NTNU
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#ifndef SYMBOLDICTIONARY_H
+#define SYMBOLDICTIONARY_H
+
+#include <QString>
+#include <QHash>
+#include <QtSql>
+
+/**
+ * Maps function/module pairs to the integer IDs stored in the measurements
+ * table.  New pairs are given the next free ID and written to the symbols
+ * table when first seen.
+ */
+class SymbolDictionary {
+  QHash<QString, unsigned> ids;
+  QSqlQuery insertQuery;
+  unsigned nextId;
+
+public:
+  SymbolDictionary(QSqlDatabase &db);
+
+  unsigned id(QString function, QString module);
+};
+
+#endif